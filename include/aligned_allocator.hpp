@@ -0,0 +1,44 @@
+#ifndef ALIGNED_ALLOCATOR_HPP
+#define ALIGNED_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/* Cache-line (and widest SIMD register) aligned storage for parameter and
+ * gradient buffers */
+inline constexpr size_t CACHE_LINE = 64;
+
+template <typename T, size_t Align = CACHE_LINE>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Align>;
+  };
+
+  AlignedAllocator() noexcept = default;
+  template <typename U>
+  constexpr explicit AlignedAllocator(
+      const AlignedAllocator<U, Align> &) noexcept {}
+
+  [[nodiscard]] T *allocate(const size_t n) {
+    return static_cast<T *>(
+        ::operator new(n*sizeof(T), std::align_val_t{Align}));
+  }
+  void deallocate(T *p, size_t) noexcept {
+    ::operator delete(p, std::align_val_t{Align});
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Align> &) const noexcept {
+    return true;
+  }
+};
+
+template <typename T>
+using aligned_vector = std::vector<T, AlignedAllocator<T>>;
+
+#endif //ALIGNED_ALLOCATOR_HPP
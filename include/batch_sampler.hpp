@@ -0,0 +1,83 @@
+#ifndef BATCH_SAMPLER_HPP
+#define BATCH_SAMPLER_HPP
+
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+#include "batch_view.hpp"
+#include "idx_dataset.hpp"
+
+enum class Sampling {
+  shuffle,     // a fresh permutation every epoch
+  stratified,  // as shuffle, but every batch keeps the class proportions
+  weighted,    // drawn with replacement, by per-class weight
+};
+
+/**
+  \name BatchSampler
+  \details
+  Hands out an epoch's batches lazily as BatchViews over one index buffer.
+  set_epoch(e) redraws the order from (seed, e) in O(n), or O(n x classes)
+  for stratified sampling. Every process with the same seed therefore sees
+  the same batches, and a different order each epoch, without copying any
+  samples. \n
+  Weighted sampling draws n samples with replacement, each with
+  probability proportional to its class's weight. The default weight is the
+  inverse class count, which balances the classes. \n
+  Views returned by batch() are invalidated by the next set_epoch().
+**/
+class BatchSampler {
+  const uint8_t *images_;
+  std::span<const uint8_t> labels_;
+  size_t image_size_;
+  std::vector<size_t> indices_;  // the samples to draw from
+  std::vector<size_t> order_;    // this epoch's, batch after batch
+  std::vector<std::vector<size_t>> by_class_;
+  std::vector<double> class_weights_;
+  size_t batch_size_;
+  uint32_t seed_;
+  Sampling sampling_;
+  size_t epoch_{0};
+
+  void shuffle(std::mt19937 &gen);
+  void stratify(std::mt19937 &gen);
+  void draw_weighted(std::mt19937 &gen);
+
+ public:
+  /* labels: one per image of the storage; indices: the samples to use,
+   * e.g. IdxDataset::Split::training */
+  BatchSampler(const uint8_t *images,
+               std::span<const uint8_t> labels,
+               size_t image_size,
+               std::vector<size_t> indices,
+               size_t batch_size,
+               uint32_t seed,
+               Sampling sampling = Sampling::shuffle,
+               std::vector<double> class_weights = {});
+  BatchSampler(const IdxDataset &dataset,
+               std::vector<size_t> indices,
+               size_t batch_size,
+               uint32_t seed,
+               Sampling sampling = Sampling::shuffle,
+               std::vector<double> class_weights = {});
+
+  void set_epoch(size_t epoch);
+  [[nodiscard]] size_t epoch() const noexcept { return epoch_; }
+  [[nodiscard]] size_t size() const noexcept { return order_.size(); }
+  [[nodiscard]] size_t batch_size() const noexcept { return batch_size_; }
+  [[nodiscard]] size_t num_batches() const noexcept {
+    return (order_.size() + batch_size_ - 1)/batch_size_;
+  }
+  /* Samples per class among the indices */
+  [[nodiscard]] std::vector<size_t> class_counts() const;
+
+  /* Batch i of this epoch (the last may be smaller), or this rank's shard
+   * of it */
+  [[nodiscard]] BatchView batch(size_t i) const;
+  [[nodiscard]] BatchView batch(size_t i, size_t rank, size_t world_size) const {
+    return batch(i).shard(rank, world_size);
+  }
+};
+
+#endif //BATCH_SAMPLER_HPP
@@ -0,0 +1,127 @@
+#ifndef BATCH_VIEW_HPP
+#define BATCH_VIEW_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "idx_dataset.hpp"
+#include "pixels.hpp"
+
+/**
+  \name BatchView
+  \details
+  A batch of samples in dataset storage: contiguous uint8_t images of
+  image_size() pixels each and one label per image, e.g. an IdxDataset.
+  The samples are either the contiguous range [first, first + count) or,
+  when indices are given, the listed samples in that order. \n
+  Only pointers are held, so the dataset (and the index list) must outlive
+  the view. Copying a view is cheap; nothing is converted until gather()
+  writes the batch into a caller's buffer.
+**/
+class BatchView {
+  const uint8_t *images_{nullptr};
+  const uint8_t *labels_{nullptr};
+  size_t image_size_{0};
+  size_t first_{0};
+  size_t count_{0};
+  std::span<const size_t> indices_{};
+
+ public:
+  BatchView() = default;
+  BatchView(const uint8_t *images, const uint8_t *labels,
+            const size_t image_size, const size_t first, const size_t count)
+      : images_(images), labels_(labels), image_size_(image_size),
+        first_(first), count_(count) {}
+  BatchView(const uint8_t *images, const uint8_t *labels,
+            const size_t image_size, const std::span<const size_t> indices)
+      : images_(images), labels_(labels), image_size_(image_size),
+        count_(indices.size()), indices_(indices) {}
+  BatchView(const IdxDataset &dataset, const size_t first, const size_t count)
+      : BatchView(dataset.images().data(), dataset.labels().data(),
+                  dataset.image_size(), first, count) {
+    if (first + count > dataset.size())
+      throw std::out_of_range("BatchView past the end of the dataset.");
+  }
+  BatchView(const IdxDataset &dataset, const std::span<const size_t> indices)
+      : BatchView(dataset.images().data(), dataset.labels().data(),
+                  dataset.image_size(), indices) {
+    for (const auto i : indices) {
+      if (i >= dataset.size())
+        throw std::out_of_range("BatchView index past the end of the dataset.");
+    }
+  }
+
+  [[nodiscard]] size_t size() const noexcept { return count_; }
+  [[nodiscard]] bool empty() const noexcept { return count_==0; }
+  [[nodiscard]] size_t image_size() const noexcept { return image_size_; }
+  [[nodiscard]] bool contiguous() const noexcept { return indices_.empty(); }
+
+  /* Dataset index of the i-th sample */
+  [[nodiscard]] size_t index(const size_t i) const noexcept {
+    return contiguous() ? first_ + i : indices_[i];
+  }
+  [[nodiscard]] const uint8_t *image(const size_t i) const noexcept {
+    return images_ + index(i)*image_size_;
+  }
+  [[nodiscard]] uint8_t label(const size_t i) const noexcept {
+    return labels_[index(i)];
+  }
+
+  /* Samples [lo, hi) of this batch, e.g. a micro-batch or a shard */
+  [[nodiscard]] BatchView subview(const size_t lo, const size_t hi) const {
+    if (lo > hi || hi > count_)
+      throw std::out_of_range("BatchView::subview out of range.");
+    if (contiguous())
+      return {images_, labels_, image_size_, first_ + lo, hi - lo};
+    return {images_, labels_, image_size_, indices_.subspan(lo, hi - lo)};
+  }
+
+  /* This rank's slice, as DataHandler::get_batched_training_shard */
+  [[nodiscard]] BatchView shard(const size_t rank,
+                                const size_t world_size) const {
+    return subview(count_*rank/world_size, count_*(rank + 1)/world_size);
+  }
+
+  /* Writes the batch as a size() x image_size() matrix, one sample per row */
+  template <typename T>
+  void gather(T *out, const PixelScale<T> &scale = {}) const noexcept {
+    if (contiguous()) {
+      scale.convert(image(0), count_*image_size_, out);
+      return;
+    }
+    for (size_t i = 0; i < count_; i++, out += image_size_)
+      scale.convert(image(i), image_size_, out);
+  }
+
+  /* The labels in batch order. A contiguous view points into the dataset,
+   * otherwise they are gathered into scratch. */
+  std::span<const uint8_t> labels(std::vector<uint8_t> &scratch) const {
+    if (contiguous()) return {labels_ + first_, count_};
+    scratch.resize(count_);
+    for (size_t i = 0; i < count_; i++) scratch[i] = label(i);
+    return scratch;
+  }
+};
+
+/* Consecutive batches of batch_size samples over indices (the last one
+ * may be smaller), each cut down to this rank's shard */
+inline std::vector<BatchView> make_batches(const IdxDataset &dataset,
+                                           const std::span<const size_t> indices,
+                                           const size_t batch_size,
+                                           const size_t rank = 0,
+                                           const size_t world_size = 1) {
+  if (batch_size==0)
+    throw std::invalid_argument("make_batches expects a non-zero batch size.");
+  std::vector<BatchView> batches;
+  batches.reserve((indices.size() + batch_size - 1)/batch_size);
+  for (size_t lo = 0; lo < indices.size(); lo += batch_size) {
+    const size_t n = std::min(batch_size, indices.size() - lo);
+    batches.push_back(BatchView(dataset, indices.subspan(lo, n))
+                          .shard(rank, world_size));
+  }
+  return batches;
+}
+
+#endif //BATCH_VIEW_HPP
@@ -0,0 +1,51 @@
+#ifndef BFLOAT16_HPP
+#define BFLOAT16_HPP
+
+#include <bit>
+#include <cstdint>
+
+/**
+  \name bfloat16
+  \details
+  Storage type holding the upper half of an IEEE binary32: the same exponent
+  range as float with an 8-bit significand. Arithmetic happens after
+  converting back to float. \n
+  The float constructor rounds to nearest even. stochastic() instead rounds
+  up with probability proportional to the discarded low half, so repeated
+  small updates (e.g. an exponential moving average) survive on average
+  rather than being rounded away.
+**/
+struct bfloat16 {
+  uint16_t bits{0};
+
+  bfloat16() = default;
+  explicit bfloat16(const float x) noexcept {
+    const auto u = std::bit_cast<uint32_t>(x);
+    bits = is_nan(u) ? quiet_nan(u)
+                     : static_cast<uint16_t>(
+                         (u + 0x7fffu + ((u >> 16) & 1u)) >> 16);
+  }
+
+  /* random: uniform 16 bits, added below the kept half before truncating */
+  static bfloat16 stochastic(const float x, const uint16_t random) noexcept {
+    const auto u = std::bit_cast<uint32_t>(x);
+    bfloat16 result;
+    result.bits = is_nan(u) ? quiet_nan(u)
+                            : static_cast<uint16_t>((u + random) >> 16);
+    return result;
+  }
+
+  explicit operator float() const noexcept {
+    return std::bit_cast<float>(static_cast<uint32_t>(bits) << 16);
+  }
+
+ private:
+  static constexpr bool is_nan(const uint32_t u) noexcept {
+    return (u & 0x7fffffffu) > 0x7f800000u;
+  }
+  static constexpr uint16_t quiet_nan(const uint32_t u) noexcept {
+    return static_cast<uint16_t>((u >> 16) | 0x40u);
+  }
+};
+
+#endif //BFLOAT16_HPP
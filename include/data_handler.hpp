@@ -8,7 +8,9 @@
 inline constexpr double TRAIN_SPLIT = 0.80;
 inline constexpr double VALIDATION_SPLIT = 0.10;
 
-using image_t = std::vector<double>;
+template <typename T>
+using image_type = std::vector<T>;
+using image_t = image_type<double>;
 using label_t = uint8_t;
 using data_vec_t = std::vector<Data *>;
 using data_batch_t = std::vector<data_vec_t>;
@@ -22,6 +24,7 @@ class DataHandler {
   size_t total_length_{};
   size_t image_size_{};
   std::map<uint8_t, size_t> class_map_{};
+  uint32_t split_seed_;
 
   static void append_data(const std::vector<size_t> &,
                           std::vector<Data *> *,
@@ -34,6 +37,9 @@ class DataHandler {
   DataHandler();
   ~DataHandler();
   [[maybe_unused]] DataHandler(const std::string &, const std::string &);
+  /* Seeds the train/validation/test split, e.g. so that every rank of a
+   * distributed run sees the same one */
+  DataHandler(const std::string &, const std::string &, uint32_t split_seed);
   DataHandler(const DataHandler &) = delete;
   DataHandler(DataHandler &&) = delete;
   DataHandler &operator=(const DataHandler &) = delete;
@@ -55,6 +61,9 @@ class DataHandler {
   [[nodiscard]] const std::vector<Data *> *get_test_data() const;
   [[nodiscard]] std::vector<std::vector<Data *>> get_batched_training_data(
       size_t) const;
+  /* This rank's slice of every training batch */
+  [[nodiscard]] std::vector<std::vector<Data *>> get_batched_training_shard(
+      size_t batch_size, size_t rank, size_t world_size) const;
   [[nodiscard]] std::vector<std::vector<Data *>> get_batched_validation_data(
       size_t) const;
   [[nodiscard]] std::vector<std::vector<Data *>> get_batched_test_data(size_t) const;
@@ -63,13 +72,18 @@ class DataHandler {
   void print_class_info() const;
 };
 
-std::tuple<image_t, label_t>
+/* Features are converted to T on extraction, e.g. extract<float>(...) */
+template <typename T = double>
+std::tuple<image_type<T>, label_t>
 extract(const Data *d);
 
-std::tuple<std::vector<image_t>, std::vector<label_t>>
+template <typename T = double>
+std::tuple<std::vector<image_type<T>>, std::vector<label_t>>
 extract(const data_vec_t *data);
 
-std::tuple<std::vector<std::vector<image_t>>, std::vector<std::vector<label_t>>>
+template <typename T = double>
+std::tuple<std::vector<std::vector<image_type<T>>>,
+           std::vector<std::vector<label_t>>>
 extract(const data_batch_t &batched_data);
 
 #endif //DATA_HANDLER_HPP
\ No newline at end of file
@@ -0,0 +1,107 @@
+#ifndef DATA_PARALLEL_HPP
+#define DATA_PARALLEL_HPP
+
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "components.hpp"
+#include "thread_pool.hpp"
+
+/**
+  \name DataParallel
+  \details
+  Synchronous data-parallel training. Each batch is split into one
+  contiguous shard per replica and the shards are run concurrently on the
+  pool. Every replica shares the model's parameters but accumulates its own
+  grads, on its thread's private tapes, through its own Loss. \n
+  The replicas' grads are then all-reduced into the model's: the parameter
+  range is split over the pool and each chunk sums every replica in a fixed
+  order. Each grad is read and written once, whatever the replica count. A
+  single optimiser step follows. \n
+  Each shard is weighted by its share of the batch (see
+  Loss::stream_backward), so the loss and update match train_single_batch up
+  to summation order. Replica 0 is the model itself.
+**/
+template <typename T, class Loss>
+class DataParallel {
+  std::shared_ptr<const MLP<T>> model_;
+  /* replicas_[0] is unused, replica 0 accumulates into model_ */
+  std::vector<std::shared_ptr<MLP<T>>> replicas_;
+  std::vector<std::unique_ptr<Loss>> losses_;
+  ThreadPool &pool_;
+  size_t micro_batch_;
+  T loss_{static_cast<T>(0)};
+
+  static constexpr size_t REDUCE_GRAIN = 4096;
+
+  void all_reduce() {
+    const auto &grad = model_->get_parameters()[0].grad;
+    pool_.parallel_for(0, grad.size(), [&](const size_t lo, const size_t hi) {
+      for (size_t r = 1; r < replicas_.size(); r++) {
+        const T *src = replicas_[r]->get_parameters()[0].grad.data();
+        for (size_t i = lo; i < hi; i++) grad[i] += src[i];
+      }
+    }, REDUCE_GRAIN);
+  }
+
+ public:
+  /* micro_batch: samples per forward/backward within a shard, 0 for the
+   * whole shard at once */
+  explicit DataParallel(const std::shared_ptr<const MLP<T>> &model,
+                        const size_t num_replicas =
+                            ThreadPool::global().num_workers() + 1,
+                        ThreadPool &pool = ThreadPool::global(),
+                        const size_t micro_batch = 0)
+      : model_(model), pool_(pool), micro_batch_(micro_batch) {
+    if (num_replicas==0)
+      throw std::invalid_argument("DataParallel needs at least one replica.");
+    replicas_.resize(num_replicas);
+    losses_.emplace_back(std::make_unique<Loss>(model_));
+    for (size_t r = 1; r < num_replicas; r++) {
+      replicas_[r] = std::make_shared<MLP<T>>(*model_);
+      replicas_[r]->share_parameters(*model_);
+      losses_.emplace_back(std::make_unique<Loss>(replicas_[r]));
+    }
+  }
+
+  [[nodiscard]] size_t num_replicas() const noexcept { return losses_.size(); }
+  /* Mean loss of the last batch */
+  [[nodiscard]] T get() const noexcept { return loss_; }
+
+  /* Forward, backward, all-reduce and one optimiser.step(). The model's
+   * grads are zeroed afterwards. */
+  template <class Optimiser>
+  void train_batch(std::span<const typename Loss::input_type> inputs,
+                   std::span<const typename Loss::target_type> targets,
+                   Optimiser &optimiser) {
+    if (targets.size()!=inputs.size()) {
+      throw std::invalid_argument(
+          "train_batch expects one target per input.");
+    }
+    const size_t n = inputs.size();
+    const size_t shards = num_replicas();
+    pool_.parallel_for(0, shards, [&](const size_t lo, const size_t hi) {
+      for (size_t r = lo; r < hi; r++) {
+        const size_t begin = n*r/shards;
+        const size_t end = n*(r + 1)/shards;
+        if (r > 0) replicas_[r]->zero_grad();
+        if (begin==end) {
+          losses_[r]->zero();
+          continue;
+        }
+        losses_[r]->stream_backward(
+            inputs.subspan(begin, end - begin),
+            targets.subspan(begin, end - begin),
+            micro_batch_ ? micro_batch_ : end - begin, n);
+      }
+    });
+    all_reduce();
+    loss_ = 0;
+    for (const auto &l : losses_) loss_ += l->get();
+    optimiser.step();
+    model_->zero_grad();
+  }
+};
+
+#endif //DATA_PARALLEL_HPP
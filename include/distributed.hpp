@@ -0,0 +1,211 @@
+#ifndef DISTRIBUTED_HPP
+#define DISTRIBUTED_HPP
+
+#include <array>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "batch_sampler.hpp"
+#include "batch_view.hpp"
+#include "components.hpp"
+#include "process_group.hpp"
+#include "tensor.hpp"
+
+/**
+  \name DistributedDataParallel
+  \details
+  Synchronous data-parallel training across the processes of a
+  ProcessGroup. Each rank trains on its own slice of every batch (see
+  DataHandler::get_batched_training_shard), the grads are summed over the
+  ranks, and every rank takes the same optimiser step, so the models stay
+  identical. Rank 0's parameters are broadcast at construction; an optimiser
+  built earlier only reads them at its first step. \n
+  On the tensor path each parameter's grads are handed to the
+  communication thread as soon as backward has finished them. The last
+  layer's reduction then overlaps with the backward pass through the
+  earlier layers. The scalar path reduces the whole gradient arena after
+  backward. \n
+  Each shard is weighted by its share of the global batch (see
+  Loss::stream_backward), so the result matches single-process training on
+  the whole batch up to summation order.
+**/
+template <typename T, class Loss>
+class DistributedDataParallel {
+  std::shared_ptr<const MLP<T>> model_;
+  ProcessGroup &group_;
+  Loss loss_;
+  T loss_value_{static_cast<T>(0)};
+
+ public:
+  DistributedDataParallel(const std::shared_ptr<const MLP<T>> &model,
+                          ProcessGroup &group)
+      : model_(model), group_(group), loss_(model) {
+    group_.broadcast(model_->get_parameters()[0].data);
+  }
+
+  [[nodiscard]] const ProcessGroup &group() const noexcept { return group_; }
+  /* Mean loss of the last global batch */
+  [[nodiscard]] T get() const noexcept { return loss_value_; }
+
+  /* inputs and targets are this rank's shard of the batch. Every rank must
+   * call this the same number of times. */
+  template <class Optimiser>
+  void train_batch(std::span<const typename Loss::input_type> inputs,
+                   std::span<const typename Loss::target_type> targets,
+                   Optimiser &optimiser) {
+    if (targets.size()!=inputs.size()) {
+      throw std::invalid_argument(
+          "train_batch expects one target per input.");
+    }
+    step(inputs.size(), optimiser, [&](const size_t batch_size) {
+      loss_.stream_backward(inputs, targets, inputs.size(), batch_size);
+    });
+  }
+  /* The same for a shard that points into dataset storage */
+  template <class Optimiser>
+  void train_batch(const BatchView &shard, Optimiser &optimiser) {
+    step(shard.size(), optimiser, [&](const size_t batch_size) {
+      loss_.stream_backward(shard, shard.size(), batch_size);
+    });
+  }
+
+ private:
+  /* backward(batch_size) accumulates this rank's n samples into the grads,
+   * weighted by the global batch size */
+  template <class Optimiser, class Backward>
+  void step(const size_t n, Optimiser &optimiser, Backward backward) {
+    /* the global batch size, and whether any shard is empty, which every
+     * rank has to know to fail together */
+    std::array<double, 2> counts{static_cast<double>(n), n==0 ? 1.0 : 0.0};
+    group_.all_reduce(std::span<double>(counts));
+    if (counts[1] > 0)
+      throw std::invalid_argument("Every rank needs a non-empty shard.");
+
+    const auto &grad = model_->get_parameters()[0].grad;
+    auto &tape = TensorTape<T>::get();
+    size_t reduced = 0;
+    tape.set_grad_ready_hook([&](T *g, const size_t size) {
+      group_.all_reduce_async(std::span<T>(g, size));
+      reduced += size;
+    });
+    try {
+      backward(static_cast<size_t>(counts[0]));
+    } catch (...) {
+      tape.set_grad_ready_hook({});
+      throw;
+    }
+    tape.set_grad_ready_hook({});
+    if (reduced==0) {
+      group_.all_reduce_async(grad);
+    } else if (reduced!=grad.size()) {
+      throw std::logic_error(
+          "Backward reached only some of the model's parameters.");
+    }
+    std::array<T, 1> loss{loss_.get()};
+    group_.all_reduce_async(std::span<T>(loss));
+    group_.wait();
+    loss_value_ = loss[0];
+    optimiser.step();
+    model_->zero_grad();
+  }
+};
+
+/* train_batched_dataset for one rank of a distributed run. The batches are
+ * this rank's shards; only rank 0 reports. */
+template <typename T, class Loss, class Optimiser>
+void train_batched_dataset(DistributedDataParallel<T, Loss> &trainer,
+                           const std::shared_ptr<const MLP<T>> &model,
+                           const std::vector<typename Loss::batched_input_type> &batched_img_ds,
+                           const std::vector<typename Loss::batched_target_type> &batched_tgt_ds,
+                           const std::vector<typename Loss::input_type> &eval_imgs,
+                           const std::vector<typename Loss::target_type> &eval_tgts,
+                           Optimiser &optimiser,
+                           const size_t epochs) {
+  const bool report = trainer.group().rank()==0;
+  const auto num_batches = batched_img_ds.size();
+  for (size_t e = 0; e < epochs; e++) {
+    if (report) {
+      std::cout << "============ Training ============\n";
+      std::cout << "Epoch " << e + 1 << '/' << epochs << '\n';
+    }
+    double epoch_loss = 0;
+    for (size_t i = 0; i < num_batches; i++) {
+      trainer.train_batch(batched_img_ds[i], batched_tgt_ds[i], optimiser);
+      epoch_loss += trainer.get();
+      if (report) {
+        std::cout << "Batch " << i + 1 << '/' << num_batches << ", Accuracy = "
+                  << model->predict_batch(eval_imgs, eval_tgts).accuracy
+                  << '\n';
+      }
+    }
+    if (report)
+      std::cout << "Epoch loss" << ": " << epoch_loss/num_batches << '\n';
+  }
+}
+
+/* The same over this rank's shards of batches in dataset storage, e.g.
+ * make_batches(..., rank, world_size) */
+template <typename T, class Loss, class Optimiser>
+void train_batched_dataset(DistributedDataParallel<T, Loss> &trainer,
+                           const std::shared_ptr<const MLP<T>> &model,
+                           std::span<const BatchView> shards,
+                           const BatchView &eval,
+                           Optimiser &optimiser,
+                           const size_t epochs) {
+  const bool report = trainer.group().rank()==0;
+  const auto num_batches = shards.size();
+  for (size_t e = 0; e < epochs; e++) {
+    if (report) {
+      std::cout << "============ Training ============\n";
+      std::cout << "Epoch " << e + 1 << '/' << epochs << '\n';
+    }
+    double epoch_loss = 0;
+    for (size_t i = 0; i < num_batches; i++) {
+      trainer.train_batch(shards[i], optimiser);
+      epoch_loss += trainer.get();
+      if (report) {
+        std::cout << "Batch " << i + 1 << '/' << num_batches << ", Accuracy = "
+                  << model->predict_batch(eval).accuracy << '\n';
+      }
+    }
+    if (report)
+      std::cout << "Epoch loss" << ": " << epoch_loss/num_batches << '\n';
+  }
+}
+
+/* The same with a fresh order every epoch. Every rank must use a sampler
+ * with the same seed, so that they take the shards of the same batches. */
+template <typename T, class Loss, class Optimiser>
+void train_batched_dataset(DistributedDataParallel<T, Loss> &trainer,
+                           const std::shared_ptr<const MLP<T>> &model,
+                           BatchSampler &sampler,
+                           const BatchView &eval,
+                           Optimiser &optimiser,
+                           const size_t epochs) {
+  const auto &group = trainer.group();
+  const bool report = group.rank()==0;
+  for (size_t e = 0; e < epochs; e++) {
+    sampler.set_epoch(e);
+    const auto num_batches = sampler.num_batches();
+    if (report) {
+      std::cout << "============ Training ============\n";
+      std::cout << "Epoch " << e + 1 << '/' << epochs << '\n';
+    }
+    double epoch_loss = 0;
+    for (size_t i = 0; i < num_batches; i++) {
+      trainer.train_batch(sampler.batch(i, group.rank(), group.world_size()),
+                          optimiser);
+      epoch_loss += trainer.get();
+      if (report) {
+        std::cout << "Batch " << i + 1 << '/' << num_batches << ", Accuracy = "
+                  << model->predict_batch(eval).accuracy << '\n';
+      }
+    }
+    if (report)
+      std::cout << "Epoch loss" << ": " << epoch_loss/num_batches << '\n';
+  }
+}
+
+#endif //DISTRIBUTED_HPP
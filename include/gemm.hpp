@@ -0,0 +1,39 @@
+#ifndef GEMM_HPP
+#define GEMM_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+  \name gemm
+  \details
+  C ← op(A)·op(B) (+ C when accumulate is set) for row-major matrices, where
+  op(X) is X, or Xᵀ when the matching trans flag is set. \n
+  op(A) is m x k, op(B) is k x n and C is m x n. lda, ldb and ldc are the row
+  strides of the matrices as stored. \n
+  Large products are packed into cache-sized blocks and run through a
+  register-tiled micro-kernel picked at runtime from the widest instruction
+  set the CPU supports; small ones, such as single-sample GEMVs, use plain
+  unit-stride loops.
+**/
+template <typename T>
+void gemm(bool trans_a, bool trans_b,
+          size_t m, size_t n, size_t k,
+          const T *a, size_t lda,
+          const T *b, size_t ldb,
+          T *c, size_t ldc,
+          bool accumulate);
+
+enum class GemmIsa : uint8_t {
+  scalar,  // portable 4 x 4 kernel
+  avx2,    // AVX2 + FMA
+  avx512,  // AVX-512F
+};
+
+GemmIsa gemm_isa() noexcept;
+/* Select a kernel, e.g. for benchmarking. Requests beyond what the CPU
+ * supports fall back to the best supported one, which is returned. */
+GemmIsa set_gemm_isa(GemmIsa isa) noexcept;
+const char *to_string(GemmIsa isa) noexcept;
+
+#endif //GEMM_HPP
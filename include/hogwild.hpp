@@ -0,0 +1,135 @@
+#ifndef HOGWILD_HPP
+#define HOGWILD_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "components.hpp"
+#include "thread_pool.hpp"
+
+struct HogwildStats {
+  size_t samples{0};
+  double seconds{0};
+  double samples_per_sec{0};
+  double loss{0};      // mean training loss over the epoch
+  double accuracy{0};  // on the evaluation set, if one was given
+};
+
+inline std::ostream &operator<<(std::ostream &os, const HogwildStats &stats) {
+  os << "HogwildStats(samples=" << stats.samples
+     << ", samples_per_sec=" << stats.samples_per_sec
+     << ", loss=" << stats.loss
+     << ", accuracy=" << stats.accuracy << ")";
+  return os;
+}
+
+/**
+  \name Hogwild
+  \details
+  Asynchronous lock-free SGD. One worker per replica claims samples from a
+  shared counter, runs forward and backward on its own replica, and applies
+  w -= step_size·clip(g) straight to the shared parameters. Replicas share
+  the model's parameters and keep private grads (see
+  MLP::share_parameters). \n
+  Updates go through relaxed std::atomic_ref loads and stores, but the
+  forward passes (gemm, row_dot) read the same weights with plain loads
+  while other workers store to them. That is a data race, which Hogwild
+  accepts, as it accepts a read-modify-write losing a concurrent update. No
+  atomicity is guaranteed for the weights. Only non-zero grads are written,
+  so sparse inputs touch few of the first layer's weights. \n
+  Replica 0 is the model itself.
+**/
+template <typename T, class Loss>
+class Hogwild {
+  std::shared_ptr<const MLP<T>> model_;
+  std::vector<std::shared_ptr<MLP<T>>> replicas_;  // [0] unused, see above
+  std::vector<std::unique_ptr<Loss>> losses_;
+  ThreadPool &pool_;
+  double step_size_;
+  T clip_;
+
+  /* Apply and clear one replica's grads */
+  void update(const Parameter<T> &param) const noexcept {
+    T *w = param.data.data();
+    T *g = param.grad.data();
+    for (size_t i = 0; i < param.grad.size(); i++) {
+      if (g[i]==static_cast<T>(0)) continue;
+      std::atomic_ref<T> weight(w[i]);
+      const T delta = static_cast<T>(step_size_)*std::clamp(g[i], -clip_, clip_);
+      weight.store(weight.load(std::memory_order_relaxed) - delta,
+                   std::memory_order_relaxed);
+      g[i] = static_cast<T>(0);
+    }
+  }
+
+ public:
+  explicit Hogwild(const std::shared_ptr<const MLP<T>> &model,
+                   const double step_size = 1e-2,
+                   const size_t num_workers =
+                       ThreadPool::global().num_workers() + 1,
+                   ThreadPool &pool = ThreadPool::global(),
+                   const T clip_val = static_cast<T>(1))
+      : model_(model), pool_(pool), step_size_(step_size), clip_(clip_val) {
+    if (num_workers==0)
+      throw std::invalid_argument("Hogwild needs at least one worker.");
+    replicas_.resize(num_workers);
+    losses_.emplace_back(std::make_unique<Loss>(model_));
+    for (size_t r = 1; r < num_workers; r++) {
+      replicas_[r] = std::make_shared<MLP<T>>(*model_);
+      replicas_[r]->share_parameters(*model_);
+      losses_.emplace_back(std::make_unique<Loss>(replicas_[r]));
+    }
+  }
+
+  [[nodiscard]] size_t num_workers() const noexcept { return losses_.size(); }
+
+  /* One pass over the samples in order, then the accuracy on the evaluation
+   * set when one is given */
+  HogwildStats train_epoch(std::span<const typename Loss::input_type> inputs,
+                           std::span<const typename Loss::target_type> targets,
+                           const std::vector<std::vector<T>> &eval_inputs = {},
+                           const std::vector<uint8_t> &eval_targets = {}) {
+    if (targets.size()!=inputs.size()) {
+      throw std::invalid_argument(
+          "train_epoch expects one target per input.");
+    }
+    model_->zero_grad();
+    std::atomic<size_t> next{0};
+    std::vector<double> losses(num_workers(), 0.0);
+    const auto start = std::chrono::steady_clock::now();
+    pool_.parallel_for(0, num_workers(), [&](const size_t lo, const size_t hi) {
+      for (size_t r = lo; r < hi; r++) {
+        const auto &param = (r ? replicas_[r]->get_parameters()
+                               : model_->get_parameters())[0];
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed);
+             i < inputs.size();
+             i = next.fetch_add(1, std::memory_order_relaxed)) {
+          losses_[r]->stream_backward(inputs.subspan(i, 1),
+                                      targets.subspan(i, 1));
+          losses[r] += static_cast<double>(losses_[r]->get());
+          update(param);
+        }
+      }
+    });
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    HogwildStats stats;
+    stats.samples = inputs.size();
+    stats.seconds = elapsed.count();
+    stats.samples_per_sec = static_cast<double>(inputs.size())/stats.seconds;
+    for (const double l : losses) stats.loss += l;
+    if (!inputs.empty()) stats.loss /= static_cast<double>(inputs.size());
+    if (!eval_inputs.empty())
+      stats.accuracy =
+          model_->predict_batch(eval_inputs, eval_targets, false, pool_).accuracy;
+    return stats;
+  }
+};
+
+#endif //HOGWILD_HPP
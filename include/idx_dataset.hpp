@@ -0,0 +1,74 @@
+#ifndef IDX_DATASET_HPP
+#define IDX_DATASET_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+  \name IdxDataset
+  \details
+  An IDX image file and its label file (the MNIST format) mapped read-only
+  into memory. Both headers are validated once on construction, and the
+  images are then served as views into the mapping: one contiguous
+  size() x image_size() uint8_t matrix, one image per row. Nothing is
+  copied or converted, and the pages are loaded lazily by the OS. \n
+  Throws std::runtime_error for files that can't be mapped, bad magic
+  numbers, mismatched counts or sizes that disagree with the headers.
+**/
+class IdxDataset {
+  struct Mapping {
+    const uint8_t *data{nullptr};
+    size_t size{0};
+  };
+
+  Mapping image_file_;
+  Mapping label_file_;
+  size_t size_{0};
+  size_t rows_{0};
+  size_t cols_{0};
+  std::vector<size_t> class_counts_;  // counted once on construction
+
+  static Mapping map(const std::string &path);
+  static void unmap(Mapping &mapping) noexcept;
+
+ public:
+  IdxDataset(const std::string &image_path, const std::string &label_path);
+  ~IdxDataset();
+  IdxDataset(const IdxDataset &) = delete;
+  IdxDataset &operator=(const IdxDataset &) = delete;
+  IdxDataset(IdxDataset &&other) noexcept;
+  IdxDataset &operator=(IdxDataset &&other) noexcept;
+
+  [[nodiscard]] size_t size() const noexcept { return size_; }
+  [[nodiscard]] size_t rows() const noexcept { return rows_; }
+  [[nodiscard]] size_t cols() const noexcept { return cols_; }
+  [[nodiscard]] size_t image_size() const noexcept { return rows_*cols_; }
+
+  [[nodiscard]] std::span<const uint8_t> images() const noexcept;
+  [[nodiscard]] std::span<const uint8_t> image(size_t i) const noexcept;
+  [[nodiscard]] std::span<const uint8_t> labels() const noexcept;
+  [[nodiscard]] uint8_t label(const size_t i) const noexcept {
+    return labels()[i];
+  }
+  /* Samples per label, indexed by label up to the largest one */
+  [[nodiscard]] const std::vector<size_t> &class_counts() const noexcept {
+    return class_counts_;
+  }
+  [[nodiscard]] size_t num_classes() const noexcept {
+    return class_counts_.size();
+  }
+
+  /* Index lists of a seeded random split, as DataHandler::split_data */
+  struct Split {
+    std::vector<size_t> training;
+    std::vector<size_t> validation;
+    std::vector<size_t> test;
+  };
+  [[nodiscard]] Split split(uint32_t seed,
+                            double training = 0.8,
+                            double validation = 0.1) const;
+};
+
+#endif //IDX_DATASET_HPP
@@ -2,15 +2,35 @@
 #define LAYER_HPP
 
 #include <vector>
+#include "aligned_allocator.hpp"
 #include "module.hpp"
 #include "neuron.hpp"
+#include "tensor.hpp"
 
+/* Holds an nout x nin row-major weight matrix followed by the bias vector
+ * in one aligned buffer, [W | b], and the matching grads, [dW | db], in
+ * another. The layer owns both until attach() moves them into a model's
+ * arena. The buffers are mutable since the optimiser and backward update
+ * them through const model handles. */
 template <typename T>
 class Layer final : public Module<T> {
-  std::vector<Neuron<T>> neurons_;
+  size_t nin_;
+  size_t nout_;
+  /* [W | b | dW | db] while the layer owns its parameters, empty once
+   * attached */
+  mutable aligned_vector<T> storage_;
+  T *params_{nullptr};
+  T *grads_{nullptr};
+  Parameter<T> param_;
   UnaryOp activation_;
   size_t num_params_;
 
+  void point_to(T *params, T *grads) noexcept;
+  [[nodiscard]] T *weights() const noexcept { return params_; }
+  [[nodiscard]] T *bias() const noexcept { return params_ + nout_*nin_; }
+  [[nodiscard]] T *weight_grad() const noexcept { return grads_; }
+  [[nodiscard]] T *bias_grad() const noexcept { return grads_ + nout_*nin_; }
+
  public:
   Layer(size_t nin, size_t nout, const UnaryOp &activation);
   Layer(const Layer &other);
@@ -19,9 +39,26 @@ class Layer final : public Module<T> {
   Layer &operator=(Layer &&other) noexcept;
   Output<T> operator()(const std::vector<Value<T>> &inputs) const;
   Output<T> operator()(const std::vector<T> &input) const;
+  TensorValue<T> operator()(const TensorValue<T> &inputs) const;
+  /* The pre-activation outputs x·Wᵀ + b, for losses that fuse the final
+   * softmax into their own node */
+  Output<T> logits(const std::vector<Value<T>> &inputs) const;
+  TensorValue<T> logits(const TensorValue<T> &inputs) const;
+  [[nodiscard]] UnaryOp activation() const noexcept { return activation_; }
   [[nodiscard]] ParamVector<T> get_parameters() const override;
+  /* Move the parameters and grads into caller-owned buffers of num_params()
+   * values each, which must outlive the layer. Copies of an attached layer
+   * own their parameters again. */
+  void attach(T *params, T *grads);
+  /* Read the parameters from params, num_params() values owned elsewhere,
+   * while keeping this layer's grads */
+  void share_parameters(T *params) noexcept { point_to(params, grads_); }
   [[nodiscard]] constexpr size_t num_params() const noexcept { return num_params_; }
+  [[nodiscard]] size_t nin() const noexcept { return nin_; }
+  [[nodiscard]] size_t nout() const noexcept { return nout_; }
+  [[nodiscard]] Neuron<T> neuron(size_t i) const noexcept;
   [[nodiscard]] std::vector<T> predict(const std::vector<T> &input) const;
+  void predict(const T *input, size_t batch, T *output) const;
 };
 
 #endif //LAYER_HPP
@@ -2,7 +2,12 @@
 #define LOSSES_HPP
 
 #include <chrono>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include "batch_view.hpp"
 #include "value.hpp"
+#include "tensor.hpp"
 #include "module.hpp"
 
 // CRTP
@@ -17,6 +22,9 @@ class Loss {
  protected:
   const std::shared_ptr<const MLP<T>> mptr_;
   Value<T> value_{static_cast<T>(0)};
+  /* set instead of value_ when the whole batch goes through the tensor path */
+  std::optional<TensorValue<T>> batch_value_;
+  T loss_{static_cast<T>(0)};  // survives the tape reset in Optimiser::step
   static constexpr T eps_{1e-7};
 
  public:
@@ -30,25 +38,213 @@ class Loss {
 
   constexpr void compute_loss(const input_type &input,
                               const target_type &target) {
+    begin_scalar();
     static_cast<Derived *>(this)->compute_loss_impl(input, target);
+    loss_ = value_.get_data();
   }
+  /* Losses that implement compute_batch_loss_impl run the batch as one
+   * batch x features matrix through the tensor path, the rest fall back to
+   * accumulating per-sample scalar graphs. */
   void compute_loss(const batched_input_type &batched_input,
                     const batched_target_type &batched_target) {
+    auto *derived = static_cast<Derived *>(this);
+    if constexpr (requires {
+      derived->compute_batch_loss_impl(batched_input, batched_target);
+    }) {
+      derived->compute_batch_loss_impl(batched_input, batched_target);
+      loss_ = batch_value_->data()[0];
+      return;
+    }
     for (size_t i = 0; i < batched_input.size(); ++i) {
       compute_loss(batched_input[i], batched_target[i]);
     }
     value_ /= static_cast<T>(batched_input.size());
+    loss_ = value_.get_data();
+  }
+
+  /* A batch that is already an input matrix, e.g. TensorValue::from_pixels,
+   * with one class label per row. For losses that implement batch_loss. */
+  void compute_loss(const TensorValue<T> &inputs,
+                    std::span<const uint8_t> labels) {
+    static_cast<Derived *>(this)->batch_loss(inputs, labels);
+    loss_ = batch_value_->data()[0];
+  }
+
+  /* A batch read straight from dataset storage. The pixels are scaled as
+   * they are gathered into the tape, so nothing is copied beforehand. */
+  void compute_loss(const BatchView &batch, const PixelScale<T> &scale = {}) {
+    record(batch, scale);
+    if (batch_value_) {
+      loss_ = batch_value_->data()[0];
+      return;
+    }
+    value_ /= static_cast<T>(batch.size());
+    loss_ = value_.get_data();
+  }
+
+  /* Forward and backward micro_batch samples at a time, accumulating into
+   * the parameter grads and resetting the tapes in between, so only one
+   * micro-batch's graph is alive at once. Each micro-batch is weighted by its
+   * share of the batch, so the grads and get() match compute_loss() on the
+   * whole batch followed by backward(), up to summation order. \n
+   * batch_size: when the inputs are one shard of a larger batch, that
+   * batch's size. The grads and get() are then this shard's contribution to
+   * the batch mean. Defaults to the number of inputs. */
+  void stream_backward(std::span<const input_type> batched_input,
+                       std::span<const target_type> batched_target,
+                       const size_t micro_batch = 1,
+                       const size_t batch_size = 0) {
+    if (batched_target.size()!=batched_input.size()) {
+      throw std::invalid_argument(
+          "stream_backward expects one target per input.");
+    }
+    auto *derived = static_cast<Derived *>(this);
+    stream(batched_input.size(), micro_batch, batch_size,
+           [&](const size_t lo, const size_t hi) {
+      if constexpr (requires(const TensorValue<T> &inputs) {
+        derived->batch_loss(inputs, batched_target);
+      }) {
+        /* the rows go straight into the tape, as in record() */
+        const size_t cols = batched_input[lo].size();
+        auto inputs = TensorValue<T>::input(hi - lo, cols);
+        T *out = inputs.data();
+        for (size_t i = lo; i < hi; i++) {
+          ops::check_shapes(batched_input[i].size()==cols, "stream_backward");
+          out = std::copy(batched_input[i].begin(), batched_input[i].end(),
+                          out);
+        }
+        derived->batch_loss(inputs, batched_target.subspan(lo, hi - lo));
+      } else {
+        for (size_t i = lo; i < hi; i++)
+          derived->compute_loss_impl(batched_input[i], batched_target[i]);
+      }
+    });
+  }
+  void stream_backward(const BatchView &batch,
+                       const size_t micro_batch = 1,
+                       const size_t batch_size = 0,
+                       const PixelScale<T> &scale = {}) {
+    stream(batch.size(), micro_batch, batch_size,
+           [&](const size_t lo, const size_t hi) {
+      record(batch.subview(lo, hi), scale);
+    });
+  }
+
+  /* A batch already prepared as rows x cols inputs (e.g. by a Prefetcher)
+   * with one class label per row. For losses that implement batch_loss. */
+  void stream_backward(const T *inputs,
+                       const size_t cols,
+                       std::span<const uint8_t> labels,
+                       const size_t micro_batch = 1,
+                       const size_t batch_size = 0) {
+    stream(labels.size(), micro_batch, batch_size,
+           [&](const size_t lo, const size_t hi) {
+      static_cast<Derived *>(this)->batch_loss(
+          TensorValue<T>::input(inputs + lo*cols, hi - lo, cols),
+          labels.subspan(lo, hi - lo));
+    });
+  }
+
+ private:
+  /* The scalar paths accumulate into value_. After a tensor-path batch
+   * (whose value_ may point into a tape that has since been reset) they
+   * start over, so backward() always follows the path recorded last. */
+  void begin_scalar() {
+    if (!batch_value_) return;
+    batch_value_.reset();
+    value_ = Value(static_cast<T>(0));
+  }
+
+  /* Records the loss of batch: its mean in batch_value_ on the tensor path,
+   * or the sum over its samples added to value_ on the scalar path */
+  void record(const BatchView &batch, const PixelScale<T> &scale) {
+    auto *derived = static_cast<Derived *>(this);
+    if constexpr (requires(const TensorValue<T> &inputs) {
+      derived->batch_loss(inputs, std::span<const uint8_t>{});
+    }) {
+      auto inputs = TensorValue<T>::input(batch.size(), batch.image_size());
+      batch.gather(inputs.data(), scale);
+      std::vector<uint8_t> labels;
+      derived->batch_loss(inputs, batch.labels(labels));
+    } else {
+      static_assert(std::is_same_v<target_type, uint8_t>,
+                    "BatchView labels are class indices");
+      begin_scalar();
+      input_type input(batch.image_size());
+      for (size_t i = 0; i < batch.size(); i++) {
+        scale.convert(batch.image(i), input.size(), input.data());
+        derived->compute_loss_impl(input, batch.label(i));
+      }
+    }
+  }
+
+  /* The micro-batch loop of stream_backward. forward(lo, hi) records
+   * samples [lo, hi) as record() does. */
+  template <class Forward>
+  void stream(const size_t n, const size_t micro_batch, size_t batch_size,
+              Forward forward) {
+    if (micro_batch==0) {
+      throw std::invalid_argument(
+          "stream_backward expects a non-zero micro-batch size.");
+    }
+    if (batch_size==0) batch_size = n;
+    T total = 0;
+    for (size_t lo = 0; lo < n; lo += micro_batch) {
+      const size_t hi = std::min(n, lo + micro_batch);
+      zero();
+      forward(lo, hi);
+      if (batch_value_) {
+        const T weight = static_cast<T>(hi - lo)/static_cast<T>(batch_size);
+        total += weight*batch_value_->data()[0];
+        batch_value_->backward(weight);
+      } else {
+        value_ /= static_cast<T>(batch_size);
+        total += value_.get_data();
+        value_.backward();
+      }
+      Tape<T>::get().reset();
+      TensorTape<T>::get().reset();
+    }
+    zero();
+    loss_ = total;
+  }
+
+ public:
+  /* A softmax output layer is folded into the loss's own
+   * softmax_cross_entropy node, which takes the logits instead */
+  [[nodiscard]] bool fuses_softmax() const noexcept {
+    return mptr_->output_activation()==UnaryOp::softmax;
+  }
+
+ protected:
+  /* Cross entropy of the class labels over a batch, on the tensor path */
+  template <typename Label>
+  void class_loss(const TensorValue<T> &inputs, std::span<const Label> labels) {
+    if (fuses_softmax()) {
+      batch_value_ = ops::softmax_cross_entropy(mptr_->logits(inputs), labels);
+      return;
+    }
+    batch_value_ = ops::nll_loss(mptr_->operator()(inputs), labels, eps_);
   }
 
-  constexpr void zero() noexcept { value_ = Value(static_cast<T>(0)); }
+ public:
+
+  constexpr void zero() noexcept {
+    value_ = Value(static_cast<T>(0));
+    batch_value_.reset();
+    loss_ = static_cast<T>(0);
+  }
   virtual void clamp(Output<T> &output) {
     for (auto &val : output) {
       val.get_data() = std::clamp(val.get_data(),
                                   this->eps_, 1 - this->eps_);
     }
   }
-  constexpr T get() const noexcept { return value_.get_data(); }
-  void backward() noexcept { value_.backward(); }
+  constexpr T get() const noexcept { return loss_; }
+  void backward() {
+    if (batch_value_) batch_value_->backward();
+    else value_.backward();
+  }
 };
 
 /*============================================================================*/
@@ -63,10 +259,25 @@ class SparseCCELoss final : public Loss<SparseCCELoss<T>, T, uint8_t> {
   // Implement compute_loss for single input
   void compute_loss_impl(const Loss::input_type &input,
                          const Loss::target_type &target) {
+    if (this->fuses_softmax()) {
+      this->value_ += ops::softmax_cross_entropy(this->mptr_->logits(input),
+                                                 target);
+      return;
+    }
     auto outputs = this->mptr_->operator()(input);
     this->clamp(outputs);
     this->value_ -= log(outputs[target]);
   }
+
+  void compute_batch_loss_impl(const Loss::batched_input_type &inputs,
+                               const Loss::batched_target_type &targets) {
+    batch_loss(TensorValue<T>(inputs, false), targets);
+  }
+
+  void batch_loss(const TensorValue<T> &inputs,
+                  std::span<const uint8_t> labels) {
+    this->class_loss(inputs, labels);
+  }
 };
 
 /*============================================================================*/
@@ -90,11 +301,35 @@ class CCELoss final : public Loss<CCELoss<T>, T, std::vector<uint8_t>> {
 
   void compute_loss_impl(const Loss::input_type &input,
                          const Loss::target_type &target) {
+    const auto index = get_index(target);
+    if (this->fuses_softmax()) {
+      this->value_ += ops::softmax_cross_entropy(this->mptr_->logits(input),
+                                                 index);
+      return;
+    }
     auto output = this->mptr_->operator()(input);
     this->clamp(output);
-    const auto index = get_index(target);
     this->value_ -= log(output[index]);
   }
+
+  void compute_batch_loss_impl(const Loss::batched_input_type &inputs,
+                               const Loss::batched_target_type &targets) {
+    batch_loss(TensorValue<T>(inputs, false), targets);
+  }
+
+  void batch_loss(const TensorValue<T> &inputs,
+                  std::span<const typename Loss::target_type> targets) {
+    std::vector<size_t> indices;
+    indices.reserve(targets.size());
+    for (const auto &t : targets) indices.emplace_back(get_index(t));
+    this->class_loss(inputs, std::span<const size_t>(indices));
+  }
+
+  /* labels are class indices, as for SparseCCELoss */
+  void batch_loss(const TensorValue<T> &inputs,
+                  std::span<const uint8_t> labels) {
+    this->class_loss(inputs, labels);
+  }
 };
 
 /*============================================================================*/
@@ -111,13 +346,15 @@ class MSELoss final : public Loss<MSELoss<T>, T, uint8_t> {
     auto output = this->mptr_->operator()(input);
     this->clamp(output);
 
+    /* averaged on its own so earlier samples in value_ aren't rescaled */
+    auto sample = Value(static_cast<T>(0));
     for (size_t i = 0; i < output.size(); i++) {
       if (i==static_cast<size_t>(target))
-        this->value_ += ops::pow(output[i] - 1.0, static_cast<T>(2));
+        sample += ops::pow(output[i] - 1.0, static_cast<T>(2));
       else
-        this->value_ += ops::pow(output[i], static_cast<T>(2));
+        sample += ops::pow(output[i], static_cast<T>(2));
     }
-    this->value_ /= output.size();
+    this->value_ += sample/static_cast<T>(output.size());
   }
 };
 
@@ -1,13 +1,49 @@
 #ifndef MODEL_HPP
 #define MODEL_HPP
 
+#include <span>
+#include <vector>
+#include "batch_view.hpp"
 #include "module.hpp"
 #include "layer.hpp"
 #include "neuron.hpp"
+#include "pixels.hpp"
+#include "thread_pool.hpp"
 
+/* Result of MLP::predict_batch. accuracy and confusion are only filled in
+ * when targets are given; confusion is num_classes x num_classes, counted at
+ * [target*num_classes + prediction]. */
+struct BatchPredictions {
+  std::vector<uint8_t> labels;
+  double accuracy{0};
+  size_t num_classes{0};
+  std::vector<size_t> confusion;
+
+  [[nodiscard]] size_t confusion_at(const size_t target,
+                                    const size_t prediction) const {
+    return confusion.at(target*num_classes + prediction);
+  }
+};
+
+/* The layers' parameters live back to back in one arena, [W | b] per
+ * layer, with the grads mirrored in a second one. get_parameters() returns
+ * a single Parameter over the whole model. */
 template <typename T>
 class MLP final : public Module<T> {
   std::vector<Layer<T>> layers_;
+  mutable aligned_vector<T> params_;
+  mutable aligned_vector<T> grads_;
+  Parameter<T> param_;
+
+  void register_parameters();
+  /* Shared by the predict_batch overloads. load(i, row) writes input i into
+   * row, the input tile of the current micro-batch. */
+  template <class Load>
+  BatchPredictions predict_rows(size_t n,
+                                std::span<const uint8_t> targets,
+                                bool with_confusion,
+                                ThreadPool &pool,
+                                Load load) const;
 
  public:
   MLP(const MLP &other);
@@ -15,12 +51,40 @@ class MLP final : public Module<T> {
   MLP(MLP &&other) noexcept = delete;
   MLP &operator=(MLP &&other) noexcept = delete;
   explicit MLP(const std::vector<Layer<T>> &layers);
-  explicit MLP(std::vector<Layer<T>> &&layers) noexcept;
+  explicit MLP(std::vector<Layer<T>> &&layers);
   ParamVector<T> get_parameters() const override;
+  /* Read the parameters from source's arena instead of this model's own, so
+   * updates to source are seen here without copying. The grads stay
+   * private, e.g. for data-parallel replicas. source must outlive this model
+   * and have the same layer shapes. */
+  void share_parameters(const MLP &source);
   void zero_grad() const;
   Output<T> operator()(const std::vector<Value<T>> &inputs) const;
   Output<T> operator()(const std::vector<T> &input) const;
+  TensorValue<T> operator()(const TensorValue<T> &inputs) const;
+  /* Forward pass stopping before the last layer's activation */
+  Output<T> logits(const std::vector<T> &input) const;
+  TensorValue<T> logits(const TensorValue<T> &inputs) const;
+  [[nodiscard]] UnaryOp output_activation() const noexcept {
+    return layers_.back().activation();
+  }
   uint8_t predict(const std::vector<T> &input) const;
+  BatchPredictions predict_batch(const std::vector<std::vector<T>> &inputs,
+                                 const std::vector<uint8_t> &targets = {},
+                                 bool with_confusion = false,
+                                 ThreadPool &pool = ThreadPool::global()) const;
+  /* pixels: contiguous images, nin bytes each (e.g. IdxDataset::images()),
+   * converted by scale as each micro-batch's tile is filled */
+  BatchPredictions predict_batch(std::span<const uint8_t> pixels,
+                                 std::span<const uint8_t> targets = {},
+                                 const PixelScale<T> &scale = {},
+                                 bool with_confusion = false,
+                                 ThreadPool &pool = ThreadPool::global()) const;
+  /* Samples of a dataset with their labels as targets, see BatchView */
+  BatchPredictions predict_batch(const BatchView &batch,
+                                 const PixelScale<T> &scale = {},
+                                 bool with_confusion = false,
+                                 ThreadPool &pool = ThreadPool::global()) const;
 };
 
 #endif //MODEL_HPP
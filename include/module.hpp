@@ -2,14 +2,24 @@
 #define MODULE_HPP
 
 #include <random>
+#include <span>
 #include "value.hpp"
 #include "utils.hpp"
 
 template <typename T>
 using Output = std::vector<Value<T>>;
 
+/* A contiguous run of parameters and their gradients */
 template <typename T>
-using ParamVector = std::vector<std::shared_ptr<Value<T>>>;
+struct Parameter {
+  std::span<T> data;
+  std::span<T> grad;
+};
+
+/* Views of a module's parameter runs, valid as long as the module. Modules
+ * keep their Parameters, so handing these out never allocates. */
+template <typename T>
+using ParamVector = std::span<const Parameter<T>>;
 
 // interface
 template <typename T>
@@ -1,25 +1,31 @@
 #ifndef NEURON_HPP
 #define NEURON_HPP
 
+#include <array>
 #include <vector>
 #include "module.hpp"
 
+/* A view of one row of a Layer's weight matrix. The Layer owns the
+ * parameters and their grads; a Neuron only refers to them. */
 template <typename T>
 class Neuron final : public Module<T> {
-  std::vector<Value<T>> weights_;
-  Value<T> bias_;
+  ops::ParamRow<T> row_;
+  std::array<Parameter<T>, 2> params_;  // the weight row and the bias
   UnaryOp activation_{UnaryOp::relu};
 
  public:
-  Neuron(size_t nin, size_t nout, const UnaryOp &activation);
-  Neuron(const Neuron &other);
-  Neuron(Neuron &&other) noexcept;
-  Neuron &operator=(const Neuron &other);
-  Neuron &operator=(Neuron &&other) noexcept;
+  Neuron(T *weights, T *weight_grad, T *bias, T *bias_grad,
+         size_t nin, const UnaryOp &activation);
+  Neuron(const Neuron &other) = default;
+  Neuron(Neuron &&other) noexcept = default;
+  Neuron &operator=(const Neuron &other) = default;
+  Neuron &operator=(Neuron &&other) noexcept = default;
   [[nodiscard]] ParamVector<T> get_parameters() const override;
   Value<T> operator()(const std::vector<Value<T>> &input) const;
   Value<T> operator()(const std::vector<T> &input) const;
   [[nodiscard]] T predict(const std::vector<T> &input) const;
+  [[nodiscard]] T predict(const T *input) const noexcept;
+  [[nodiscard]] size_t size() const noexcept { return row_.size; }
 };
 
 #endif //NEURON_HPP
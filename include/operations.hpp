@@ -1,24 +1,29 @@
 #ifndef OPERATIONS_HPP
 #define OPERATIONS_HPP
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 
 template <typename T>
-class Value_;
+class Tape;
 
 template <typename T>
 class Value;
 
 namespace ops {
 
-enum class BinaryOp {
+enum class BinaryOp : uint8_t {
   add,
   subtract,
   multiply,
   divide,
 };
 
-enum class UnaryOp {
+enum class UnaryOp : uint8_t {
   tanh,
   relu,
   softmax,
@@ -27,132 +32,264 @@ enum class UnaryOp {
   pow,
 };
 
+enum class NaryOp : uint8_t {
+  dot,
+  row_dot,
+  softmax_cross_entropy,
+};
+
+/* One row of a layer's weight matrix with its bias, and their grads */
 template <typename T>
-inline void register_op(const Value<T> &operand,
-                        Value<T> &result,
-                        const UnaryOp &op) {
-  Value_<T> *operand_ptr = operand.get_ptr().get();
-  Value_<T> *result_ptr = result.get_ptr().get();
+struct ParamRow {
+  T *weights;
+  T *weight_grad;
+  T *bias;
+  T *bias_grad;
+  size_t size;
+};
+
+/* Which of the op enums a tape node's tag refers to */
+enum class OpType : uint8_t {
+  leaf,
+  unary,
+  binary,
+  nary,
+};
+
+template <typename T>
+using index_t = typename Tape<T>::index_t;
 
-  std::function<void()> backward_function;
+/* Propagate the grad of node idx into its operand */
+template <typename T>
+inline void backward(Tape<T> &tape, const index_t<T> idx, const UnaryOp op) {
+  const auto operand = tape.lhs(idx);
+  const T grad = tape.grad(idx);
   switch (op) {
-    case UnaryOp::exp:
-      backward_function = [operand_ptr, result_ptr] {
-        operand_ptr->get_grad() +=
-            result_ptr->get_grad()*result_ptr->get_data();
-      };
+    case UnaryOp::exp:tape.grad(operand) += grad*tape.data(idx);
       break;
-    case UnaryOp::ln:
-      backward_function = [operand_ptr, result_ptr] {
-        operand_ptr->get_grad() +=
-            result_ptr->get_grad()/operand_ptr->get_data();
-      };
+    case UnaryOp::ln:tape.grad(operand) += grad/tape.data(operand);
       break;
     case UnaryOp::relu:
-      backward_function = [operand_ptr, result_ptr] {
-        if (operand_ptr->get_data() > static_cast<T>(0))
-          operand_ptr->get_grad() += result_ptr->get_grad();
-      };
+      if (tape.data(operand) > static_cast<T>(0))
+        tape.grad(operand) += grad;
       break;
     case UnaryOp::tanh:
-      backward_function = [operand_ptr, result_ptr] {
-        operand_ptr->get_grad() +=
-            (1 - std::pow(result_ptr->get_data(), 2))*
-                result_ptr->get_grad();
-      };
+      tape.grad(operand) += (1 - tape.data(idx)*tape.data(idx))*grad;
+      break;
+    case UnaryOp::pow: {
+      const T e = tape.aux(idx);
+      tape.grad(operand) +=
+          e*std::pow(tape.data(operand), e - static_cast<T>(1))*grad;
+      break;
+    }
+    default:break;
+  }
+}
+
+/* Propagate the grad of node idx into both of its operands */
+template <typename T>
+inline void backward(Tape<T> &tape, const index_t<T> idx, const BinaryOp op) {
+  const auto left = tape.lhs(idx);
+  const auto right = tape.rhs(idx);
+  const T grad = tape.grad(idx);
+  switch (op) {
+    case BinaryOp::add:tape.grad(left) += grad;
+      tape.grad(right) += grad;
+      break;
+    case BinaryOp::subtract:tape.grad(left) += grad;
+      tape.grad(right) -= grad;
+      break;
+    case BinaryOp::multiply:tape.grad(left) += tape.data(right)*grad;
+      tape.grad(right) += tape.data(left)*grad;
+      break;
+    case BinaryOp::divide:tape.grad(left) += grad/tape.data(right);
+      tape.grad(right) +=
+          -tape.data(left)*grad/(tape.data(right)*tape.data(right));
+      break;
+    default:break;
+  }
+}
+
+/* Propagate the grad of node idx into its operand list */
+template <typename T>
+inline void backward(Tape<T> &tape, const index_t<T> idx, const NaryOp op) {
+  const T grad = tape.grad(idx);
+  switch (op) {
+    case NaryOp::dot: {
+      /* lhs is the bias, the operand list holds (weight, input) pairs */
+      tape.grad(tape.lhs(idx)) += grad;
+      const auto n = tape.num_operands(tape.rhs(idx));
+      const auto *pairs = tape.operands(tape.rhs(idx));
+      for (index_t<T> i = 0; i < n; i += 2) {
+        const auto w = pairs[i];
+        const auto x = pairs[i + 1];
+        tape.grad(w) += grad*tape.data(x);
+        tape.grad(x) += grad*tape.data(w);
+      }
+      break;
+    }
+    case NaryOp::row_dot: {
+      /* lhs is the parameter row, the operand list holds one input per
+       * weight */
+      const auto &row = tape.param_row(tape.lhs(idx));
+      const auto *inputs = tape.operands(tape.rhs(idx));
+      *row.bias_grad += grad;
+      for (size_t i = 0; i < row.size; i++) {
+        row.weight_grad[i] += grad*tape.data(inputs[i]);
+        tape.grad(inputs[i]) += grad*row.weights[i];
+      }
+      break;
+    }
+    case NaryOp::softmax_cross_entropy: {
+      /* the operand list holds the logits, aux the target class.
+       * dz_j = softmax(z)_j - [j == target] */
+      const auto n = tape.num_operands(tape.rhs(idx));
+      const auto *logits = tape.operands(tape.rhs(idx));
+      const auto target = static_cast<index_t<T>>(tape.aux(idx));
+      T max_val = tape.data(logits[0]);
+      for (index_t<T> i = 1; i < n; i++)
+        max_val = std::max(max_val, tape.data(logits[i]));
+      T sum = 0;
+      for (index_t<T> i = 0; i < n; i++)
+        sum += std::exp(tape.data(logits[i]) - max_val);
+      for (index_t<T> i = 0; i < n; i++) {
+        const T p = std::exp(tape.data(logits[i]) - max_val)/sum;
+        tape.grad(logits[i]) +=
+            grad*(i==target ? p - static_cast<T>(1) : p);
+      }
+      break;
+    }
+    default:break;
+  }
+}
+
+template <typename T>
+inline void register_op(const Value<T> &,
+                        Value<T> &result,
+                        const UnaryOp &op) {
+  switch (op) {
+    case UnaryOp::exp:
+    case UnaryOp::ln:
+    case UnaryOp::relu:
+    case UnaryOp::tanh:result.set_op(OpType::unary, static_cast<uint8_t>(op));
       break;
     default:std::cout << "Error registering exp backward func\n";
       break;
   }
-  result.set_backward(backward_function);
 }
 
 template <typename T>
-inline void register_op(const Value<T> &operand,
+inline void register_op(const Value<T> &,
                         Value<T> &result,
                         const UnaryOp &op,
                         const int e) {
-  Value_<T> *result_ptr = result.get_ptr().get();
-  Value_<T> *operand_ptr = operand.get_ptr().get();
-
-  std::function<void()> backward_function;
   switch (op) {
     case UnaryOp::pow:
-      backward_function = [operand_ptr, result_ptr, e] {
-        operand_ptr->get_grad() +=
-            e*std::pow(operand_ptr->get_data(), e - static_cast<T>(1))*
-                result_ptr->get_grad();
-      };
+      result.set_op(OpType::unary, static_cast<uint8_t>(op),
+                    static_cast<T>(e));
       break;
     default:std::cout << "Error registering exp backward func\n";
   }
-  result.set_backward(backward_function);
 }
 
 template <typename T>
-inline void register_op(const Value<T> *left_operand,
-                        const Value<T> &right_operand,
+inline void register_op(const Value<T> *,
+                        const Value<T> &,
                         Value<T> &result,
                         const BinaryOp &op) {
-  Value_<T> *result_ptr = result.get_ptr().get();
-  Value_<T> *left_ptr = left_operand->get_ptr().get();
-  Value_<T> *right_ptr = right_operand.get_ptr().get();
+  result.set_op(OpType::binary, static_cast<uint8_t>(op));
+}
 
-  std::function<void()> backward_function;
-  switch (op) {
-    case BinaryOp::add:
-      backward_function = [left_ptr, right_ptr, result_ptr] {
-        left_ptr->get_grad() += result_ptr->get_grad();
-        right_ptr->get_grad() += result_ptr->get_grad();
-      };
-      break;
-    case BinaryOp::subtract:
-      backward_function = [left_ptr, right_ptr, result_ptr] {
-        left_ptr->get_grad() += result_ptr->get_grad();
-        right_ptr->get_grad() -= result_ptr->get_grad();
-      };
-      break;
-    case BinaryOp::multiply:
-      backward_function = [left_ptr, right_ptr, result_ptr] {
-        left_ptr->get_grad() +=
-            right_ptr->get_data()*result_ptr->get_grad();
-        right_ptr->get_grad() +=
-            left_ptr->get_data()*result_ptr->get_grad();
-      };
-      break;
-    case BinaryOp::divide:
-      backward_function = [left_ptr, right_ptr, result_ptr] {
-        left_ptr->get_grad() +=
-            result_ptr->get_grad()/right_ptr->get_data();
-        right_ptr->get_grad() +=
-            -left_ptr->get_data()*
-                result_ptr->get_grad()/std::pow(right_ptr->get_data(), 2);
-      };
-      break;
-    default:
-      std::cout << "WARNING! Setting default backward_function - [](){}\n";
-      break;
+/* Fused w·x + b recorded as a single node. Every (weight, input) pair is
+ * recorded, zero inputs included, as an input's grad is its weight's value. */
+template <typename T>
+inline Value<T> dot(const std::vector<Value<T>> &weights,
+                    const std::vector<Value<T>> &inputs,
+                    const Value<T> &bias) {
+  if (inputs.size()!=weights.size()) {
+    throw std::invalid_argument(
+        "Vector sizes must be of equal length for dot product calculation.");
+  }
+  auto &tape = Tape<T>::get();
+  const auto operands = tape.begin_operands();
+  T sum = bias.get_data();
+  for (size_t i = 0; i < inputs.size(); i++) {
+    sum += weights[i].get_data()*inputs[i].get_data();
+    tape.add_operand(operands, weights[i].index());
+    tape.add_operand(operands, inputs[i].index());
+  }
+  auto result = Value<T>(sum, bias.index(), operands);
+  result.set_op(OpType::nary, static_cast<uint8_t>(NaryOp::dot));
+  return result;
+}
+
+/* w·x + b with the weights and bias held outside the tape. Gradients are
+ * accumulated straight into the row's grad buffers. */
+template <typename T>
+inline Value<T> dot(const ParamRow<T> &row,
+                    const std::vector<Value<T>> &inputs) {
+  if (inputs.size()!=row.size) {
+    throw std::invalid_argument(
+        "Vector sizes must be of equal length for dot product calculation.");
   }
-  result.set_backward(backward_function);
+  auto &tape = Tape<T>::get();
+  const auto operands = tape.begin_operands();
+  T sum = *row.bias;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    sum += row.weights[i]*inputs[i].get_data();
+    tape.add_operand(operands, inputs[i].index());
+  }
+  auto result = Value<T>(sum, tape.add_param_row(row), operands);
+  result.set_op(OpType::nary, static_cast<uint8_t>(NaryOp::row_dot));
+  return result;
+}
+
+/* -log softmax(logits)[target] recorded as a single node, computed as
+ * logsumexp(logits) - logits[target] so no probability is ever clamped. */
+template <typename T>
+inline Value<T> softmax_cross_entropy(const std::vector<Value<T>> &logits,
+                                      const size_t target) {
+  if (target >= logits.size()) {
+    throw std::invalid_argument(
+        "Target class out of range for softmax_cross_entropy.");
+  }
+  auto &tape = Tape<T>::get();
+  const auto operands = tape.begin_operands();
+  T max_val = logits[0].get_data();
+  for (const auto &z : logits) {
+    max_val = std::max(max_val, z.get_data());
+    tape.add_operand(operands, z.index());
+  }
+  T sum = 0;
+  for (const auto &z : logits) sum += std::exp(z.get_data() - max_val);
+  const T loss = std::log(sum) + max_val - logits[target].get_data();
+  auto result = Value<T>(loss, logits[target].index(), operands);
+  result.set_op(OpType::nary,
+                static_cast<uint8_t>(NaryOp::softmax_cross_entropy),
+                static_cast<T>(target));
+  return result;
 }
 
 template <typename T>
 inline Value<T> exp(const Value<T> &operand) {
-  auto result = Value(std::exp(operand.get_data()), {operand.get_ptr()});
+  auto result = Value<T>(std::exp(operand.get_data()),
+                         operand.index(), Tape<T>::none);
   register_op<T>(operand, result, UnaryOp::exp);
   return result;
 }
 
 template <typename T, typename C>
 inline Value<T> pow(const Value<T> &obj, const C e) {
-  auto out = Value(std::pow(obj.get_data(), e), {obj.get_ptr()});
+  auto out = Value<T>(std::pow(obj.get_data(), e),
+                      obj.index(), Tape<T>::none);
   register_op<T>(obj, out, UnaryOp::pow, e);
   return out;
 }
 
 template <typename T>
 inline Value<T> log(const Value<T> &operand) {
-  auto result = Value(std::log(operand.get_data()), {operand.get_ptr()});
+  auto result = Value<T>(std::log(operand.get_data()),
+                         operand.index(), Tape<T>::none);
   register_op<T>(operand, result, UnaryOp::ln);
   return result;
 }
@@ -160,7 +297,7 @@ inline Value<T> log(const Value<T> &operand) {
 template <typename T>
 inline Value<T> relu(const Value<T> &operand) {
   T new_data = std::max(static_cast<T>(0), operand.get_data());
-  auto result = Value(new_data, {operand.get_ptr()});
+  auto result = Value<T>(new_data, operand.index(), Tape<T>::none);
   register_op<T>(operand, result, UnaryOp::relu);
   return result;
 }
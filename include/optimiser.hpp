@@ -4,8 +4,14 @@
 #include <cmath>
 #include <iostream>
 #include <memory>
+#include <variant>
 #include <vector>
+#include "aligned_allocator.hpp"
+#include "bfloat16.hpp"
 #include "module.hpp"
+#include "tape.hpp"
+#include "tensor.hpp"
+#include "thread_pool.hpp"
 #include "value.hpp"
 
 // CRTP base class
@@ -16,8 +22,28 @@ class Optimiser {
   const double step_size_;
   size_t t_{};
   const double clip_val_;
+  ThreadPool *pool_{nullptr};
+
+  /* Calls func(lo, hi) over [0, n), split across the pool when one is set.
+   * Shards start on multiples of line elements, by default a cache line of
+   * T, so workers never write to the same line. */
+  template <class Func>
+  void for_each_shard(const size_t n, Func &&func,
+                      const size_t line = CACHE_LINE/sizeof(T)) const {
+    if (!pool_ || n < MIN_SHARD) {
+      func(static_cast<size_t>(0), n);
+      return;
+    }
+    pool_->parallel_for(0, (n + line - 1)/line,
+                        [&](const size_t lo, const size_t hi) {
+                          func(lo*line, std::min(n, hi*line));
+                        }, MIN_SHARD/line);
+  }
 
  public:
+  /* Below this many parameters a shard isn't worth a task */
+  static constexpr size_t MIN_SHARD = 16384;
+
   constexpr explicit Optimiser(const std::shared_ptr<const MLP<T>> model,
                                double step_size,
                                double clip_val)
@@ -27,34 +53,102 @@ class Optimiser {
 
   virtual ~Optimiser() = default;
 
+  /* The recorded graphs have been consumed once the parameters are updated,
+   * so the tapes are reset here ready for the next forward pass. */
   void step() {
     static_cast<Derived *>(this)->step_impl();
+    Tape<T>::get().reset();
+    TensorTape<T>::get().reset();
   }
   void zero_grad();
+
+  /* Shard step() across pool, or run it serially on nullptr. Every
+   * parameter is updated by the same code either way, so the result is
+   * bit-identical to the serial step. */
+  void set_thread_pool(ThreadPool *pool) noexcept { pool_ = pool; }
+};
+
+/* Storage type of Adam's moment estimates. The update itself is always
+ * computed in double; only the stored state is narrowed, bf16 with
+ * stochastic rounding. */
+enum class StatePrecision : uint8_t {
+  float64,
+  float32,
+  bfloat16,
+};
+
+/* Kernel of the fused Adam update of double parameters, picked at runtime
+ * from what the CPU supports. All of them give bit-identical results. */
+enum class AdamIsa : uint8_t {
+  scalar,
+  avx2,
+  avx512,
 };
 
+AdamIsa adam_isa() noexcept;
+/* Select a kernel, e.g. for testing. Requests beyond what the CPU supports
+ * fall back to the best supported one, which is returned. */
+AdamIsa set_adam_isa(AdamIsa isa) noexcept;
+
 template <typename T>
 class Adam final : public Optimiser<Adam<T>, T> {
   friend class Optimiser<Adam<T>, T>;  // grant access to base
 
+  template <typename M>
+  struct Moments {
+    aligned_vector<M> m;
+    aligned_vector<M> v;
+    Moments() = default;
+    explicit Moments(const size_t size) : m(size), v(size) {}
+  };
+
   const double beta_1_;
   const double beta_2_;
   const double eps_;
-  std::vector<double> m_;
-  std::vector<double> v_;
+  std::variant<Moments<double>, Moments<float>, Moments<bfloat16>> moments_;
+  /* double copy of the parameters in mixed precision mode, else empty */
+  aligned_vector<double> master_;
 
  public:
   constexpr explicit Adam(const std::shared_ptr<const MLP<T>> model,
                           double step_size = 1e-3,
                           double beta_1 = 0.9, double beta_2 = 0.999,
-                          double eps = 1e-8, double clip_val = 1.0)
+                          double eps = 1e-8, double clip_val = 1.0,
+                          StatePrecision state = StatePrecision::float64,
+                          bool master_weights = false)
       : Optimiser<Adam<T>, T>(model, step_size, clip_val),
         beta_1_(beta_1),
         beta_2_(beta_2),
         eps_(eps) {
-    const auto size = this->mptr_->get_parameters().size();
-    m_ = std::vector<double>(size, 0);
-    v_ = std::vector<double>(size, 0);
+    size_t size = 0;
+    for (const auto &p : this->mptr_->get_parameters()) size += p.data.size();
+    /* filled from the parameters by the first step, see step_impl */
+    if (master_weights && !std::is_same_v<T, double>) master_.resize(size);
+    switch (state) {
+      case StatePrecision::float32:
+        moments_.template emplace<Moments<float>>(size);
+        break;
+      case StatePrecision::bfloat16:
+        moments_.template emplace<Moments<bfloat16>>(size);
+        break;
+      default:moments_.template emplace<Moments<double>>(size);
+    }
+  }
+
+  /* Mixed precision: the update accumulates into double master weights
+   * and the model's (e.g. float) weights are rounded copies of them */
+  [[nodiscard]] bool has_master_weights() const noexcept {
+    return !master_.empty();
+  }
+  [[nodiscard]] StatePrecision state_precision() const noexcept {
+    return static_cast<StatePrecision>(moments_.index());
+  }
+  /* Bytes held by the moment estimates */
+  [[nodiscard]] size_t state_bytes() const noexcept {
+    return std::visit([](const auto &moments) {
+      return (moments.m.size() + moments.v.size())*
+          sizeof(typename std::decay_t<decltype(moments.m)>::value_type);
+    }, moments_);
   }
 
   void step_impl();
@@ -0,0 +1,21 @@
+#ifndef PIXELS_HPP
+#define PIXELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/* Affine map from raw uint8_t pixels to model inputs, x = p*scale + offset.
+ * The default matches DataHandler::normalise_data. Applied while an input
+ * tile is loaded, so datasets can stay in memory at one byte per pixel. */
+template <typename T>
+struct PixelScale {
+  T scale{static_cast<T>(1)/static_cast<T>(255)};
+  T offset{static_cast<T>(0)};
+
+  void convert(const uint8_t *pixels, const size_t n, T *out) const noexcept {
+    for (size_t i = 0; i < n; i++)
+      out[i] = static_cast<T>(pixels[i])*scale + offset;
+  }
+};
+
+#endif //PIXELS_HPP
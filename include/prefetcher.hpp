@@ -0,0 +1,231 @@
+#ifndef PREFETCHER_HPP
+#define PREFETCHER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "aligned_allocator.hpp"
+#include "batch_view.hpp"
+#include "pixels.hpp"
+
+/* A batch gathered and scaled out of dataset storage, rows x cols */
+template <typename T>
+struct PreparedBatch {
+  aligned_vector<T> inputs;
+  std::vector<uint8_t> labels;
+  size_t rows{0};
+  size_t cols{0};
+  size_t index{0};  // in the epoch
+};
+
+struct PrefetchStats {
+  size_t batches{0};          // handed to the consumer
+  double stall_seconds{0};    // consumer time spent waiting for a batch
+  double fill_seconds{0};     // worker time spent preparing batches
+  double mean_depth{0};       // ready batches found by the consumer
+  size_t max_depth{0};
+};
+
+inline std::ostream &operator<<(std::ostream &os, const PrefetchStats &stats) {
+  os << "PrefetchStats(batches=" << stats.batches
+     << ", stall_seconds=" << stats.stall_seconds
+     << ", fill_seconds=" << stats.fill_seconds
+     << ", mean_depth=" << stats.mean_depth
+     << ", max_depth=" << stats.max_depth << ")";
+  return os;
+}
+
+/**
+  \name Prefetcher
+  \details
+  Bounded producer/consumer pipeline for training batches. Worker threads
+  take the batches of an epoch in order. Each one gathers its BatchView,
+  converts the pixels with the PixelScale, runs the optional augment step,
+  and stores the result in one of depth reusable buffers. The consumer
+  meanwhile trains on the previous batch. \n
+  next() hands the batches out in epoch order whatever the number of
+  workers, so training is deterministic. A batch stays valid until the
+  following next(); only then is its buffer refilled. A worker that is
+  depth batches ahead of the consumer waits. \n
+  An exception thrown while preparing a batch is rethrown by the next() that
+  would have returned it.
+**/
+template <typename T>
+class Prefetcher {
+ public:
+  using Source = std::function<BatchView(size_t)>;  // batch i of the epoch
+  using Augment = std::function<void(PreparedBatch<T> &)>;
+
+ private:
+  using clock = std::chrono::steady_clock;
+
+  struct Slot {
+    PreparedBatch<T> batch;
+    bool ready{false};
+    std::exception_ptr error;
+  };
+
+  PixelScale<T> scale_;
+  Augment augment_;
+  Source source_;
+  std::vector<Slot> slots_;
+  std::vector<std::thread> workers_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable claimable_;  // workers: a batch and a slot free
+  std::condition_variable filled_;     // consumer: a batch ready
+  std::condition_variable idle_;       // reset(): nothing being filled
+  size_t num_batches_{0};
+  size_t claimed_{0};
+  size_t consumed_{0};   // handed out by next()
+  size_t released_{0};   // buffers given back, consumed_ or consumed_ - 1
+  size_t in_flight_{0};
+  bool stop_{false};
+  PrefetchStats stats_;
+  size_t depth_samples_{0};
+
+  void run() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+      claimable_.wait(lock, [this] {
+        return stop_ || (claimed_ < num_batches_ &&
+            claimed_ < released_ + slots_.size());
+      });
+      if (stop_) return;
+      const size_t i = claimed_++;
+      ++in_flight_;
+      Slot &slot = slots_[i%slots_.size()];
+      lock.unlock();
+
+      const auto start = clock::now();
+      std::exception_ptr error;
+      try {
+        fill(slot.batch, source_(i), i);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      const std::chrono::duration<double> took = clock::now() - start;
+
+      lock.lock();
+      slot.error = error;
+      slot.ready = true;
+      stats_.fill_seconds += took.count();
+      if (--in_flight_==0) idle_.notify_all();
+      filled_.notify_all();
+    }
+  }
+
+  void fill(PreparedBatch<T> &batch, const BatchView &view,
+            const size_t index) const {
+    batch.rows = view.size();
+    batch.cols = view.image_size();
+    batch.index = index;
+    batch.inputs.resize(batch.rows*batch.cols);
+    view.gather(batch.inputs.data(), scale_);
+    batch.labels.resize(batch.rows);
+    for (size_t i = 0; i < batch.rows; i++) batch.labels[i] = view.label(i);
+    if (augment_) augment_(batch);
+  }
+
+ public:
+  /* depth: batches prepared ahead of the consumer, at least 1 */
+  explicit Prefetcher(const size_t depth = 2,
+                      const size_t num_workers = 1,
+                      const PixelScale<T> &scale = {},
+                      Augment augment = {})
+      : scale_(scale), augment_(std::move(augment)),
+        slots_(std::max<size_t>(depth, 1)) {
+    if (num_workers==0)
+      throw std::invalid_argument("Prefetcher needs at least one worker.");
+    workers_.reserve(num_workers);
+    for (size_t w = 0; w < num_workers; w++)
+      workers_.emplace_back(&Prefetcher::run, this);
+  }
+  ~Prefetcher() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    claimable_.notify_all();
+    for (auto &w : workers_) w.join();
+  }
+  Prefetcher(const Prefetcher &) = delete;
+  Prefetcher(Prefetcher &&) = delete;
+  Prefetcher &operator=(const Prefetcher &) = delete;
+  Prefetcher &operator=(Prefetcher &&) = delete;
+
+  /* Drop the rest of the current epoch and wait for the batches being
+   * filled, after which the source is no longer read, e.g. before
+   * BatchSampler::set_epoch */
+  void reset() {
+    std::unique_lock lock(mutex_);
+    num_batches_ = 0;
+    idle_.wait(lock, [this] { return in_flight_==0; });
+    claimed_ = consumed_ = released_ = 0;
+    for (auto &slot : slots_) {
+      slot.ready = false;
+      slot.error = nullptr;
+    }
+  }
+
+  /* Begin an epoch of num_batches batches, batch i being source(i) */
+  void start(const size_t num_batches, Source source) {
+    reset();
+    {
+      std::lock_guard lock(mutex_);
+      source_ = std::move(source);
+      num_batches_ = num_batches;
+    }
+    claimable_.notify_all();
+  }
+
+  /* The next batch of the epoch, or nullptr at its end. Gives the previous
+   * batch's buffer back to the workers. */
+  const PreparedBatch<T> *next() {
+    std::unique_lock lock(mutex_);
+    if (released_ < consumed_) {
+      slots_[released_%slots_.size()].ready = false;
+      ++released_;
+      claimable_.notify_all();
+    }
+    if (consumed_ >= num_batches_) return nullptr;
+
+    size_t depth = 0;
+    for (const auto &slot : slots_) depth += slot.ready;
+    stats_.max_depth = std::max(stats_.max_depth, depth);
+    stats_.mean_depth += (static_cast<double>(depth) - stats_.mean_depth)/
+        static_cast<double>(++depth_samples_);
+
+    Slot &slot = slots_[consumed_%slots_.size()];
+    if (!slot.ready) {
+      const auto start = clock::now();
+      filled_.wait(lock, [&] { return slot.ready; });
+      const std::chrono::duration<double> waited = clock::now() - start;
+      stats_.stall_seconds += waited.count();
+    }
+    ++consumed_;
+    ++stats_.batches;
+    if (slot.error) std::rethrow_exception(slot.error);
+    return &slot.batch;
+  }
+
+  /* Totals since construction or the last reset_stats() */
+  [[nodiscard]] PrefetchStats stats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+  }
+  void reset_stats() {
+    std::lock_guard lock(mutex_);
+    stats_ = {};
+    depth_samples_ = 0;
+  }
+};
+
+#endif //PREFETCHER_HPP
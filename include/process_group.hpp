@@ -0,0 +1,89 @@
+#ifndef PROCESS_GROUP_HPP
+#define PROCESS_GROUP_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+
+/**
+  \name ProcessGroup
+  \details
+  Collective communication between world_size processes on one host. The
+  ranks form a ring of Unix-domain stream sockets: each rank listens on
+  socket_dir/micrograd-rank<r>.sock, connects to rank + 1 and accepts rank -
+  1. Only the socket setup is host-specific, so a TCP transport could be
+  dropped in for multi-host runs. \n
+  all_reduce() sums with the ring algorithm: a reduce-scatter followed by an
+  all-gather, each world_size - 1 steps of one chunk per rank. Every rank
+  sends and receives about 2·size values whatever the world size. Each chunk
+  is summed in the same order and then copied around the ring, so all ranks
+  end up with bit-identical results. \n
+  Collectives run in issue order on a communication thread. The _async
+  variants return at once so the caller can overlap them with computation,
+  e.g. reducing a layer's grads while backward carries on with earlier
+  layers. wait() blocks until everything issued has finished and rethrows
+  the first error. Every rank must issue the same collectives in the same
+  order. \n
+  from_env() reads MICROGRAD_RANK, MICROGRAD_WORLD_SIZE and
+  MICROGRAD_SOCKET_DIR (default /tmp), so N local processes can be launched
+  by hand or from a script.
+**/
+class ProcessGroup {
+ public:
+  ProcessGroup(size_t rank, size_t world_size, const std::string &socket_dir);
+  ~ProcessGroup();
+  ProcessGroup(const ProcessGroup &) = delete;
+  ProcessGroup(ProcessGroup &&) = delete;
+  ProcessGroup &operator=(const ProcessGroup &) = delete;
+  ProcessGroup &operator=(ProcessGroup &&) = delete;
+
+  static ProcessGroup from_env();
+
+  [[nodiscard]] size_t rank() const noexcept { return rank_; }
+  [[nodiscard]] size_t world_size() const noexcept { return world_size_; }
+
+  /* Sum data element-wise over all ranks, in place */
+  template <typename T>
+  void all_reduce(std::span<T> data);
+  template <typename T>
+  void all_reduce_async(std::span<T> data);
+  /* Copy root's data to every other rank */
+  template <typename T>
+  void broadcast(std::span<T> data, size_t root = 0);
+  void wait();
+
+ private:
+  size_t rank_;
+  size_t world_size_;
+  int next_{-1};  // connected to rank + 1, sends only
+  int prev_{-1};  // accepted from rank - 1, receives only
+
+  std::thread comm_;
+  std::mutex mutex_;
+  std::condition_variable work_;
+  std::condition_variable done_;
+  std::deque<std::function<void()>> jobs_;
+  size_t pending_{0};
+  bool stop_{false};
+  std::exception_ptr error_;
+
+  void connect_ring(const std::string &socket_dir);
+  void enqueue(std::function<void()> job);
+  void run();
+  /* Send to next_ and receive from prev_ at the same time, so a ring of
+   * blocking sends can't deadlock on full socket buffers */
+  void send_recv(const void *send, size_t send_bytes,
+                 void *recv, size_t recv_bytes) const;
+  template <typename T>
+  void ring_all_reduce(std::span<T> data) const;
+  template <typename T>
+  void chain_broadcast(std::span<T> data, size_t root) const;
+};
+
+#endif //PROCESS_GROUP_HPP
@@ -0,0 +1,178 @@
+#ifndef TAPE_HPP
+#define TAPE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "operations.hpp"
+
+/**
+  \name Tape
+  \details
+  Wengert list holding every scalar node recorded during the forward pass. \n
+  Node values, gradients and metadata live in contiguous arrays and parents
+  are referenced by 32-bit indices, so recording an op is an append rather
+  than a heap allocation. \n
+  Nodes below the persistent watermark (e.g. long-lived leaves) survive
+  reset(); everything above it is discarded in O(1) once the graph has been
+  consumed. \n
+  Each thread records into its own tape.
+**/
+template <typename T>
+class Tape {
+ public:
+  using index_t = uint32_t;
+  static constexpr index_t none = std::numeric_limits<index_t>::max();
+
+ private:
+  struct Node {
+    index_t lhs{none};
+    index_t rhs{none};
+    T aux{};  // op immediate, e.g. the exponent of pow
+    ops::OpType type{ops::OpType::leaf};
+    uint8_t op{0};  // ops::UnaryOp, BinaryOp or NaryOp, depending on type
+    bool track_grad{true};
+  };
+
+  std::vector<T> data_;
+  std::vector<T> grad_;
+  std::vector<Node> nodes_;
+  /* operand lists of n-ary nodes, each stored as [count, operands...] */
+  std::vector<index_t> operands_;
+  /* parameters referenced by row_dot nodes */
+  std::vector<ops::ParamRow<T>> param_rows_;
+  size_t persistent_{0};
+  size_t persistent_operands_{0};
+  size_t persistent_param_rows_{0};
+
+  std::vector<uint8_t> reachable_;  // scratch for backward, reused
+
+  Tape() = default;
+
+ public:
+  Tape(const Tape &) = delete;
+  Tape(Tape &&) = delete;
+  Tape &operator=(const Tape &) = delete;
+  Tape &operator=(Tape &&) = delete;
+
+  static Tape &get() noexcept {
+    thread_local Tape tape;
+    return tape;
+  }
+
+  index_t push(const T &data,
+               const index_t lhs = none,
+               const index_t rhs = none,
+               const bool track_grad = true) {
+    const auto idx = static_cast<index_t>(nodes_.size());
+    data_.emplace_back(data);
+    grad_.emplace_back(static_cast<T>(0));
+    nodes_.push_back(Node{lhs, rhs, T{}, ops::OpType::leaf, 0, track_grad});
+    return idx;
+  }
+
+  void set_op(const index_t idx,
+              const ops::OpType type,
+              const uint8_t op,
+              const T &aux = T{}) noexcept {
+    nodes_[idx].type = type;
+    nodes_[idx].op = op;
+    nodes_[idx].aux = aux;
+  }
+
+  const T &data(const index_t idx) const noexcept { return data_[idx]; }
+  const T &grad(const index_t idx) const noexcept { return grad_[idx]; }
+  T &data(const index_t idx) noexcept { return data_[idx]; }
+  T &grad(const index_t idx) noexcept { return grad_[idx]; }
+  [[nodiscard]] index_t lhs(const index_t idx) const noexcept {
+    return nodes_[idx].lhs;
+  }
+  [[nodiscard]] index_t rhs(const index_t idx) const noexcept {
+    return nodes_[idx].rhs;
+  }
+  const T &aux(const index_t idx) const noexcept { return nodes_[idx].aux; }
+
+  /* Open an operand list for an n-ary node, returns its offset */
+  index_t begin_operands() {
+    const auto offset = static_cast<index_t>(operands_.size());
+    operands_.emplace_back(0);
+    return offset;
+  }
+  void add_operand(const index_t offset, const index_t operand) {
+    operands_.emplace_back(operand);
+    ++operands_[offset];
+  }
+  [[nodiscard]] index_t num_operands(const index_t offset) const noexcept {
+    return operands_[offset];
+  }
+  [[nodiscard]] const index_t *operands(const index_t offset) const noexcept {
+    return operands_.data() + offset + 1;
+  }
+
+  index_t add_param_row(const ops::ParamRow<T> &row) {
+    param_rows_.emplace_back(row);
+    return static_cast<index_t>(param_rows_.size() - 1);
+  }
+  [[nodiscard]] const ops::ParamRow<T> &param_row(
+      const index_t idx) const noexcept {
+    return param_rows_[idx];
+  }
+
+  [[nodiscard]] size_t size() const noexcept { return nodes_.size(); }
+  [[nodiscard]] size_t num_persistent() const noexcept { return persistent_; }
+
+  /* Everything recorded so far survives subsequent calls to reset() */
+  void mark_persistent() noexcept {
+    persistent_ = nodes_.size();
+    persistent_operands_ = operands_.size();
+    persistent_param_rows_ = param_rows_.size();
+  }
+
+  /* Drop every node above the persistent watermark. Capacity is kept, so the
+   * next forward pass records without allocating. */
+  void reset() noexcept {
+    data_.resize(persistent_);
+    grad_.resize(persistent_);
+    nodes_.resize(persistent_);
+    operands_.resize(persistent_operands_);
+    param_rows_.resize(persistent_param_rows_);
+  }
+
+  /* Nodes are always recorded after their operands, so walking the tape in
+   * reverse creation order from the root is a valid topological order. Only
+   * nodes reachable from the root (and tracking grads) are back-propagated. */
+  void backward(const index_t root) {
+    reachable_.assign(static_cast<size_t>(root) + 1, 0);
+    reachable_[root] = 1;
+    T clip_threshold = 1; // This is a hyperparameter
+    grad_[root] = static_cast<T>(1); // Set dx/dx=1 for loss Node ONLY
+    for (index_t node = root + 1; node-- > 0;) {
+      const auto &n = nodes_[node];
+      if (!reachable_[node] || !n.track_grad) continue;
+      grad_[node] = std::clamp(grad_[node], -clip_threshold, clip_threshold);
+      switch (n.type) {
+        case ops::OpType::unary:reachable_[n.lhs] = 1;
+          ops::backward(*this, node, static_cast<ops::UnaryOp>(n.op));
+          break;
+        case ops::OpType::binary:reachable_[n.lhs] = 1;
+          reachable_[n.rhs] = 1;
+          ops::backward(*this, node, static_cast<ops::BinaryOp>(n.op));
+          break;
+        case ops::OpType::nary: {
+          /* row_dot's lhs refers to a parameter row, not a node */
+          if (static_cast<ops::NaryOp>(n.op)!=ops::NaryOp::row_dot)
+            reachable_[n.lhs] = 1;
+          const auto *operands = this->operands(n.rhs);
+          for (index_t i = 0; i < num_operands(n.rhs); i++)
+            reachable_[operands[i]] = 1;
+          ops::backward(*this, node, static_cast<ops::NaryOp>(n.op));
+          break;
+        }
+        default:break;
+      }
+    }
+  }
+};
+
+#endif //TAPE_HPP
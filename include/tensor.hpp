@@ -0,0 +1,298 @@
+#ifndef TENSOR_HPP
+#define TENSOR_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include "pixels.hpp"
+#include "value.hpp"
+#include "tensor_operations.hpp"
+
+/**
+  \name TensorTape
+  \details
+  Counterpart of Tape for row-major matrices. Every tensor op records a
+  single node; node values and gradients live in two contiguous arenas and
+  nodes refer to their operands by 32-bit index. \n
+  Unlike the scalar tape nothing on it is persistent: parameters enter the
+  graph each forward pass as leaves bound to the buffers that own them, so
+  reset() clears everything. \n
+  Gradients are not clipped per node as on the scalar tape; clipping is left
+  to the optimiser. \n
+  Each thread records into its own tape.
+**/
+template <typename T>
+class TensorTape {
+ public:
+  using index_t = uint32_t;
+  static constexpr index_t none = std::numeric_limits<index_t>::max();
+
+ private:
+  struct Node {
+    size_t offset{0};  // into data_ and grad_, unless external
+    T *external_data{nullptr};
+    T *external_grad{nullptr};
+    index_t rows{0};
+    index_t cols{0};
+    index_t lhs{none};
+    index_t rhs{none};
+    size_t aux{0};  // op specific, see ops::TensorOp
+    T imm{};  // op immediate
+    ops::TensorOp op{ops::TensorOp::leaf};
+    bool track_grad{true};
+  };
+
+  std::vector<T> data_;
+  std::vector<T> grad_;
+  std::vector<Node> nodes_;
+  /* index lists of gather (scalar tape indices) and nll_loss (targets)
+   * nodes, each stored as [count, indices...] */
+  std::vector<uint32_t> indices_;
+  std::vector<uint8_t> reachable_;  // scratch for backward, reused
+  std::function<void(T *, size_t)> grad_ready_;
+
+  TensorTape() = default;
+
+ public:
+  TensorTape(const TensorTape &) = delete;
+  TensorTape(TensorTape &&) = delete;
+  TensorTape &operator=(const TensorTape &) = delete;
+  TensorTape &operator=(TensorTape &&) = delete;
+
+  static TensorTape &get() noexcept {
+    thread_local TensorTape tape;
+    return tape;
+  }
+
+  /* Append a zero-initialised rows x cols node */
+  index_t push(const size_t rows,
+               const size_t cols,
+               const ops::TensorOp op = ops::TensorOp::leaf,
+               const index_t lhs = none,
+               const index_t rhs = none,
+               const size_t aux = 0,
+               const bool track_grad = true) {
+    const auto idx = static_cast<index_t>(nodes_.size());
+    const size_t offset = data_.size();
+    data_.resize(offset + rows*cols, static_cast<T>(0));
+    grad_.resize(offset + rows*cols, static_cast<T>(0));
+    nodes_.push_back(Node{offset, nullptr, nullptr,
+                          static_cast<index_t>(rows),
+                          static_cast<index_t>(cols),
+                          lhs, rhs, aux, T{}, op, track_grad});
+    return idx;
+  }
+
+  /* Append a leaf that reads and accumulates into caller-owned buffers,
+   * which must outlive the graph */
+  index_t push_external(T *data, T *grad,
+                        const size_t rows, const size_t cols) {
+    const auto idx = static_cast<index_t>(nodes_.size());
+    nodes_.push_back(Node{0, data, grad,
+                          static_cast<index_t>(rows),
+                          static_cast<index_t>(cols),
+                          none, none, 0, T{}, ops::TensorOp::parameter,
+                          true});
+    return idx;
+  }
+
+  size_t begin_indices() {
+    const size_t offset = indices_.size();
+    indices_.emplace_back(0);
+    return offset;
+  }
+  void add_index(const size_t offset, const uint32_t idx) {
+    indices_.emplace_back(idx);
+    ++indices_[offset];
+  }
+  [[nodiscard]] const uint32_t *indices(const size_t offset) const noexcept {
+    return indices_.data() + offset + 1;
+  }
+
+  /* Pointers stay valid until the next node is recorded */
+  T *data(const index_t idx) noexcept {
+    const auto &n = nodes_[idx];
+    return n.external_data ? n.external_data : data_.data() + n.offset;
+  }
+  T *grad(const index_t idx) noexcept {
+    const auto &n = nodes_[idx];
+    return n.external_grad ? n.external_grad : grad_.data() + n.offset;
+  }
+  [[nodiscard]] size_t rows(const index_t idx) const noexcept {
+    return nodes_[idx].rows;
+  }
+  [[nodiscard]] size_t cols(const index_t idx) const noexcept {
+    return nodes_[idx].cols;
+  }
+  [[nodiscard]] index_t lhs(const index_t idx) const noexcept {
+    return nodes_[idx].lhs;
+  }
+  [[nodiscard]] index_t rhs(const index_t idx) const noexcept {
+    return nodes_[idx].rhs;
+  }
+  [[nodiscard]] size_t aux(const index_t idx) const noexcept {
+    return nodes_[idx].aux;
+  }
+  void set_imm(const index_t idx, const T &imm) noexcept {
+    nodes_[idx].imm = imm;
+  }
+  const T &imm(const index_t idx) const noexcept { return nodes_[idx].imm; }
+  [[nodiscard]] bool track_grad(const index_t idx) const noexcept {
+    return nodes_[idx].track_grad;
+  }
+
+  [[nodiscard]] size_t size() const noexcept { return nodes_.size(); }
+
+  /* Drop every node. Capacity is kept, so the next forward pass records
+   * without allocating. */
+  void reset() noexcept {
+    data_.clear();
+    grad_.clear();
+    nodes_.clear();
+    indices_.clear();
+  }
+
+  /* Seeds the root's grad with seed (by default ones, i.e. differentiates the
+   * sum of its elements), then walks the tape in reverse creation order. */
+  void backward(const index_t root, const T seed = static_cast<T>(1)) {
+    reachable_.assign(static_cast<size_t>(root) + 1, 0);
+    reachable_[root] = 1;
+    std::fill_n(grad(root), rows(root)*cols(root), seed);
+    for (index_t node = root + 1; node-- > 0;) {
+      const auto &n = nodes_[node];
+      if (!reachable_[node] || !n.track_grad) continue;
+      if (n.lhs!=none) reachable_[n.lhs] = 1;
+      if (n.rhs!=none) reachable_[n.rhs] = 1;
+      ops::backward(*this, node, n.op);
+      /* every consumer of a leaf was recorded after it, so its grad is
+       * complete once the walk reaches it */
+      if (n.op==ops::TensorOp::parameter && grad_ready_)
+        grad_ready_(grad(node), rows(node)*cols(node));
+    }
+  }
+
+  /* Called by backward() with each parameter leaf's grad buffer and size as
+   * soon as that grad is final, e.g. to start reducing it while the rest of
+   * the backward pass runs. An empty function disables it. */
+  void set_grad_ready_hook(std::function<void(T *, size_t)> hook) {
+    grad_ready_ = std::move(hook);
+  }
+};
+
+template <typename T>
+class TensorValue {
+  friend std::ostream &operator<<(std::ostream &os, const TensorValue &t) {
+    os << "TensorValue(" << t.rows() << 'x' << t.cols() << ", [";
+    for (size_t i = 0; i < t.size(); i++)
+      os << (i ? ", " : "") << t.data()[i];
+    os << "])";
+    return os;
+  }
+
+  using index_t = typename TensorTape<T>::index_t;
+  index_t idx_;
+
+  static TensorTape<T> &tape() noexcept { return TensorTape<T>::get(); }
+
+  explicit TensorValue(const index_t idx) : idx_(idx) {}
+
+ public:
+  TensorValue(const size_t rows, const size_t cols)
+      : idx_(tape().push(rows, cols)) {}
+  TensorValue(const std::vector<T> &data,
+              const size_t rows,
+              const size_t cols,
+              const bool track_grad = true)
+      : idx_(tape().push(rows, cols, ops::TensorOp::leaf,
+                         TensorTape<T>::none, TensorTape<T>::none, 0,
+                         track_grad)) {
+    ops::check_shapes(data.size()==rows*cols, "TensorValue");
+    std::copy(data.begin(), data.end(), tape().data(idx_));
+  }
+  /* One row per inner vector, e.g. a batch of samples */
+  TensorValue(const std::vector<std::vector<T>> &rows,
+              const bool track_grad = true)
+      : idx_(tape().push(rows.size(), rows.empty() ? 0 : rows.front().size(),
+                         ops::TensorOp::leaf,
+                         TensorTape<T>::none, TensorTape<T>::none, 0,
+                         track_grad)) {
+    T *out = data();
+    const size_t width = cols();
+    for (const auto &row : rows) {
+      ops::check_shapes(row.size()==width, "TensorValue");
+      out = std::copy(row.begin(), row.end(), out);
+    }
+  }
+  ~TensorValue() = default;
+  TensorValue(const TensorValue &other) = default;
+  TensorValue(TensorValue &&other) noexcept = default;
+  TensorValue &operator=(const TensorValue &other) = default;
+  TensorValue &operator=(TensorValue &&other) noexcept = default;
+
+  /* Used by the ops to append their result node */
+  static TensorValue record(const size_t rows,
+                            const size_t cols,
+                            const ops::TensorOp op,
+                            const index_t lhs = TensorTape<T>::none,
+                            const index_t rhs = TensorTape<T>::none,
+                            const size_t aux = 0) {
+    return TensorValue(tape().push(rows, cols, op, lhs, rhs, aux));
+  }
+
+  /* rows x cols leaf without a grad, for the caller to fill with inputs */
+  static TensorValue input(const size_t rows, const size_t cols) {
+    return TensorValue(tape().push(rows, cols, ops::TensorOp::leaf,
+                                   TensorTape<T>::none, TensorTape<T>::none,
+                                   0, false));
+  }
+
+  /* rows x cols input leaf copied from data, one sample per row */
+  static TensorValue input(const T *data, const size_t rows, const size_t cols) {
+    auto result = input(rows, cols);
+    std::copy_n(data, rows*cols, result.data());
+    return result;
+  }
+
+  /* rows x cols input leaf read from raw pixels, one sample per row. The
+   * pixels are scaled as they are written into the tape. */
+  static TensorValue from_pixels(const uint8_t *pixels,
+                                 const size_t rows,
+                                 const size_t cols,
+                                 const PixelScale<T> &scale = {}) {
+    auto result = input(rows, cols);
+    scale.convert(pixels, rows*cols, result.data());
+    return result;
+  }
+
+  /* rows x cols view of parameters owned elsewhere, see push_external */
+  static TensorValue bind(T *data, T *grad,
+                          const size_t rows, const size_t cols) {
+    return TensorValue(tape().push_external(data, grad, rows, cols));
+  }
+
+  [[nodiscard]] index_t index() const noexcept { return idx_; }
+  [[nodiscard]] size_t rows() const noexcept { return tape().rows(idx_); }
+  [[nodiscard]] size_t cols() const noexcept { return tape().cols(idx_); }
+  [[nodiscard]] size_t size() const noexcept { return rows()*cols(); }
+
+  /* Pointers stay valid until the next node is recorded */
+  T *data() const noexcept { return tape().data(idx_); }
+  T *grad() const noexcept { return tape().grad(idx_); }
+  const T &get_data(const size_t row, const size_t col) const noexcept {
+    return data()[row*cols() + col];
+  }
+  const T &get_grad(const size_t row, const size_t col) const noexcept {
+    return grad()[row*cols() + col];
+  }
+
+  /* seed: the grad of the loss wrt this node, e.g. a micro-batch's weight in
+   * the batch mean */
+  void backward(const T seed = static_cast<T>(1)) const {
+    tape().backward(idx_, seed);
+  }
+};
+
+#endif //TENSOR_HPP
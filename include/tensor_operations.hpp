@@ -0,0 +1,360 @@
+#ifndef TENSOR_OPERATIONS_HPP
+#define TENSOR_OPERATIONS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "gemm.hpp"
+
+template <typename T>
+class Tape;
+
+template <typename T>
+class Value;
+
+template <typename T>
+class TensorTape;
+
+template <typename T>
+class TensorValue;
+
+namespace ops {
+
+enum class TensorOp : uint8_t {
+  leaf,
+  parameter, // leaf over buffers owned outside the tape, e.g. by a Layer
+  gather,    // copy of scalar Values, grads are scattered back on backward
+  matmul,    // aux != 0: rhs is stored transposed
+  add_bias,  // rhs (1 x cols) broadcast over the rows of lhs
+  relu,
+  softmax,   // row-wise
+  exp,
+  log,
+  nll_loss,  // -mean log p[i][target_i], aux: target list, imm: clamp eps
+  softmax_cross_entropy,  // nll_loss of the row-wise softmax of lhs, aux:
+                          // target list
+};
+
+template <typename T>
+using tensor_index_t = typename TensorTape<T>::index_t;
+
+inline void check_shapes(const bool ok, const std::string &op) {
+  if (!ok)
+    throw std::invalid_argument("Incompatible tensor shapes for " + op + '.');
+}
+
+/* Propagate the grad of tensor node idx into its operands */
+template <typename T>
+inline void backward(TensorTape<T> &tape,
+                     const tensor_index_t<T> idx,
+                     const TensorOp op) {
+  const size_t rows = tape.rows(idx);
+  const size_t cols = tape.cols(idx);
+  const size_t size = rows*cols;
+  const T *out = tape.data(idx);
+  const T *dout = tape.grad(idx);
+
+  switch (op) {
+    case TensorOp::gather: {
+      auto &scalars = Tape<T>::get();
+      const auto *sources = tape.indices(tape.aux(idx));
+      for (size_t i = 0; i < size; i++)
+        scalars.grad(sources[i]) += dout[i];
+      break;
+    }
+    case TensorOp::matmul: {
+      /* C = A·B  => dA += dC·Bᵀ, dB += Aᵀ·dC
+       * C = A·Bᵀ => dA += dC·B,  dB += dCᵀ·A
+       * dA is skipped for inputs that don't track grads, e.g. the batch */
+      const auto lhs = tape.lhs(idx);
+      const auto rhs = tape.rhs(idx);
+      const bool transposed = tape.aux(idx)!=0;
+      const size_t inner = tape.cols(lhs);
+      const T *a = tape.data(lhs);
+      const T *b = tape.data(rhs);
+      if (tape.track_grad(lhs))
+        gemm(false, !transposed, rows, inner, cols,
+             dout, cols, b, transposed ? inner : cols,
+             tape.grad(lhs), inner, true);
+      if (tape.track_grad(rhs)) {
+        if (transposed)
+          gemm(true, false, cols, inner, rows,
+               dout, cols, a, inner, tape.grad(rhs), inner, true);
+        else
+          gemm(true, false, inner, cols, rows,
+               a, inner, dout, cols, tape.grad(rhs), cols, true);
+      }
+      break;
+    }
+    case TensorOp::add_bias: {
+      T *da = tape.grad(tape.lhs(idx));
+      T *db = tape.grad(tape.rhs(idx));
+      for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+          da[i*cols + j] += dout[i*cols + j];
+          db[j] += dout[i*cols + j];
+        }
+      }
+      break;
+    }
+    case TensorOp::relu: {
+      const T *in = tape.data(tape.lhs(idx));
+      T *din = tape.grad(tape.lhs(idx));
+      for (size_t i = 0; i < size; i++)
+        if (in[i] > static_cast<T>(0)) din[i] += dout[i];
+      break;
+    }
+    case TensorOp::softmax: {
+      /* dx_j = y_j·(dy_j - Σ_k dy_k·y_k) */
+      T *din = tape.grad(tape.lhs(idx));
+      for (size_t i = 0; i < rows; i++) {
+        const T *y = out + i*cols;
+        const T *dy = dout + i*cols;
+        T dot = 0;
+        for (size_t j = 0; j < cols; j++) dot += dy[j]*y[j];
+        for (size_t j = 0; j < cols; j++)
+          din[i*cols + j] += y[j]*(dy[j] - dot);
+      }
+      break;
+    }
+    case TensorOp::exp: {
+      T *din = tape.grad(tape.lhs(idx));
+      for (size_t i = 0; i < size; i++) din[i] += dout[i]*out[i];
+      break;
+    }
+    case TensorOp::log: {
+      const T *in = tape.data(tape.lhs(idx));
+      T *din = tape.grad(tape.lhs(idx));
+      for (size_t i = 0; i < size; i++) din[i] += dout[i]/in[i];
+      break;
+    }
+    case TensorOp::nll_loss: {
+      const auto probs = tape.lhs(idx);
+      const size_t batch = tape.rows(probs);
+      const size_t classes = tape.cols(probs);
+      const T eps = tape.imm(idx);
+      const T *p = tape.data(probs);
+      T *dp = tape.grad(probs);
+      const auto *targets = tape.indices(tape.aux(idx));
+      for (size_t i = 0; i < batch; i++) {
+        const size_t j = i*classes + targets[i];
+        dp[j] -= dout[0]/(static_cast<T>(batch)*
+            std::clamp(p[j], eps, static_cast<T>(1) - eps));
+      }
+      break;
+    }
+    case TensorOp::softmax_cross_entropy: {
+      /* dz_ij = (softmax(z)_ij - [j == target_i])/batch, with the softmax
+       * recomputed from the logits rather than kept on the tape */
+      const auto logits = tape.lhs(idx);
+      const size_t batch = tape.rows(logits);
+      const size_t classes = tape.cols(logits);
+      const T *z = tape.data(logits);
+      T *dz = tape.grad(logits);
+      const auto *targets = tape.indices(tape.aux(idx));
+      const T scale = dout[0]/static_cast<T>(batch);
+      for (size_t i = 0; i < batch; i++) {
+        const T *x = z + i*classes;
+        T *dx = dz + i*classes;
+        const T max_val = *std::max_element(x, x + classes);
+        T sum = 0;
+        for (size_t j = 0; j < classes; j++) sum += std::exp(x[j] - max_val);
+        const T norm = scale/sum;
+        for (size_t j = 0; j < classes; j++)
+          dx[j] += norm*std::exp(x[j] - max_val);
+        dx[targets[i]] -= scale;
+      }
+      break;
+    }
+    default:break;
+  }
+}
+
+/* Copy scalar Values into a rows x cols tensor. On backward the tensor's
+ * grad is added back onto the scalars' grads. */
+template <typename T>
+inline TensorValue<T> gather(const std::vector<Value<T>> &values,
+                             const size_t rows,
+                             const size_t cols) {
+  check_shapes(values.size()==rows*cols, "gather");
+  auto &tape = TensorTape<T>::get();
+  const auto sources = tape.begin_indices();
+  for (const auto &v : values) tape.add_index(sources, v.index());
+  auto result = TensorValue<T>::record(rows, cols, TensorOp::gather,
+                                       TensorTape<T>::none,
+                                       TensorTape<T>::none, sources);
+  T *out = result.data();
+  for (size_t i = 0; i < values.size(); i++) out[i] = values[i].get_data();
+  return result;
+}
+
+/* (m x k)·(k x n), or (m x k)·(n x k)ᵀ when transpose_rhs is set */
+template <typename T>
+inline TensorValue<T> matmul(const TensorValue<T> &lhs,
+                             const TensorValue<T> &rhs,
+                             const bool transpose_rhs = false) {
+  const size_t m = lhs.rows();
+  const size_t k = lhs.cols();
+  const size_t n = transpose_rhs ? rhs.rows() : rhs.cols();
+  check_shapes((transpose_rhs ? rhs.cols() : rhs.rows())==k, "matmul");
+  auto result = TensorValue<T>::record(m, n, TensorOp::matmul,
+                                       lhs.index(), rhs.index(),
+                                       transpose_rhs ? 1 : 0);
+  gemm(false, transpose_rhs, m, n, k,
+       lhs.data(), k, rhs.data(), transpose_rhs ? k : n,
+       result.data(), n, false);
+  return result;
+}
+
+template <typename T>
+inline TensorValue<T> add_bias(const TensorValue<T> &operand,
+                               const TensorValue<T> &bias) {
+  const size_t rows = operand.rows();
+  const size_t cols = operand.cols();
+  check_shapes(bias.size()==cols, "add_bias");
+  auto result = TensorValue<T>::record(rows, cols, TensorOp::add_bias,
+                                       operand.index(), bias.index());
+  const T *in = operand.data();
+  const T *b = bias.data();
+  T *out = result.data();
+  for (size_t i = 0; i < rows; i++)
+    for (size_t j = 0; j < cols; j++)
+      out[i*cols + j] = in[i*cols + j] + b[j];
+  return result;
+}
+
+template <typename T, class Func>
+inline TensorValue<T> elementwise(const TensorValue<T> &operand,
+                                  const TensorOp op,
+                                  Func func) {
+  auto result = TensorValue<T>::record(operand.rows(), operand.cols(), op,
+                                       operand.index());
+  const T *in = operand.data();
+  T *out = result.data();
+  for (size_t i = 0; i < operand.size(); i++) out[i] = func(in[i]);
+  return result;
+}
+
+template <typename T>
+inline TensorValue<T> relu(const TensorValue<T> &operand) {
+  return elementwise(operand, TensorOp::relu, [](const T x) {
+    return std::max(static_cast<T>(0), x);
+  });
+}
+
+template <typename T>
+inline TensorValue<T> exp(const TensorValue<T> &operand) {
+  return elementwise(operand, TensorOp::exp, [](const T x) {
+    return std::exp(x);
+  });
+}
+
+template <typename T>
+inline TensorValue<T> log(const TensorValue<T> &operand) {
+  return elementwise(operand, TensorOp::log, [](const T x) {
+    return std::log(x);
+  });
+}
+
+/* Row-wise, shifted by the row max for stability */
+template <typename T>
+inline TensorValue<T> softmax(const TensorValue<T> &operand) {
+  const size_t rows = operand.rows();
+  const size_t cols = operand.cols();
+  auto result = TensorValue<T>::record(rows, cols, TensorOp::softmax,
+                                       operand.index());
+  const T *in = operand.data();
+  T *out = result.data();
+  for (size_t i = 0; i < rows; i++) {
+    const T *x = in + i*cols;
+    T *y = out + i*cols;
+    const T max_val = *std::max_element(x, x + cols);
+    T sum = 0;
+    for (size_t j = 0; j < cols; j++) {
+      y[j] = std::exp(x[j] - max_val);
+      sum += y[j];
+    }
+    for (size_t j = 0; j < cols; j++) y[j] /= sum;
+  }
+  return result;
+}
+
+/* Mean negative log-likelihood of the targets under the row-wise
+ * probabilities, which are clamped to [eps, 1 - eps]. Returns a 1 x 1 node. */
+template <typename T, typename Target_Tp>
+inline TensorValue<T> nll_loss(const TensorValue<T> &probs,
+                               std::span<const Target_Tp> targets,
+                               const T eps) {
+  const size_t batch = probs.rows();
+  const size_t classes = probs.cols();
+  check_shapes(targets.size()==batch, "nll_loss");
+  auto &tape = TensorTape<T>::get();
+  const auto target_list = tape.begin_indices();
+  for (const auto t : targets) {
+    check_shapes(static_cast<size_t>(t) < classes, "nll_loss");
+    tape.add_index(target_list, static_cast<uint32_t>(t));
+  }
+  auto result = TensorValue<T>::record(1, 1, TensorOp::nll_loss,
+                                       probs.index(), TensorTape<T>::none,
+                                       target_list);
+  tape.set_imm(result.index(), eps);
+  const T *p = probs.data();
+  T loss = 0;
+  for (size_t i = 0; i < batch; i++)
+    loss -= std::log(std::clamp(p[i*classes + targets[i]],
+                                eps, static_cast<T>(1) - eps));
+  result.data()[0] = loss/static_cast<T>(batch);
+  return result;
+}
+template <typename T, typename Target_Tp>
+inline TensorValue<T> nll_loss(const TensorValue<T> &probs,
+                               const std::vector<Target_Tp> &targets,
+                               const T eps) {
+  return nll_loss(probs, std::span<const Target_Tp>(targets), eps);
+}
+
+/* Mean cross entropy of the targets under the row-wise softmax of the
+ * logits, as one node. Each row's loss is logsumexp(z) - z[target], so
+ * nothing is clamped. Returns a 1 x 1 node. */
+template <typename T, typename Target_Tp>
+inline TensorValue<T> softmax_cross_entropy(
+    const TensorValue<T> &logits,
+    std::span<const Target_Tp> targets) {
+  const size_t batch = logits.rows();
+  const size_t classes = logits.cols();
+  check_shapes(targets.size()==batch, "softmax_cross_entropy");
+  auto &tape = TensorTape<T>::get();
+  const auto target_list = tape.begin_indices();
+  for (const auto t : targets) {
+    check_shapes(static_cast<size_t>(t) < classes, "softmax_cross_entropy");
+    tape.add_index(target_list, static_cast<uint32_t>(t));
+  }
+  auto result = TensorValue<T>::record(1, 1, TensorOp::softmax_cross_entropy,
+                                       logits.index(), TensorTape<T>::none,
+                                       target_list);
+  const T *z = logits.data();
+  T loss = 0;
+  for (size_t i = 0; i < batch; i++) {
+    const T *x = z + i*classes;
+    const T max_val = *std::max_element(x, x + classes);
+    T sum = 0;
+    for (size_t j = 0; j < classes; j++) sum += std::exp(x[j] - max_val);
+    loss += std::log(sum) + max_val - x[targets[i]];
+  }
+  result.data()[0] = loss/static_cast<T>(batch);
+  return result;
+}
+template <typename T, typename Target_Tp>
+inline TensorValue<T> softmax_cross_entropy(
+    const TensorValue<T> &logits,
+    const std::vector<Target_Tp> &targets) {
+  return softmax_cross_entropy(logits, std::span<const Target_Tp>(targets));
+}
+}; // namespace ops
+
+#endif //TENSOR_OPERATIONS_HPP
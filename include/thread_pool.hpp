@@ -0,0 +1,175 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+struct WorkerStats {
+  uint64_t tasks_run{0};
+  uint64_t steals{0};  // tasks taken from another worker's queue
+  std::chrono::nanoseconds idle{0};  // time spent waiting for work
+};
+
+std::ostream &operator<<(std::ostream &os, const WorkerStats &stats);
+
+/**
+  \name ThreadPool
+  \details
+  Work-stealing pool. Each worker owns a deque of tasks: it pushes and pops
+  its own work at the back and, when that runs dry, steals from the front of
+  the other workers' deques before going to sleep. Tasks submitted from
+  outside the pool are dealt round-robin over the workers. \n
+  Threads blocked in parallel_for() or wait() run queued tasks rather than
+  idling, so both may be nested inside tasks. With zero workers everything
+  runs inline on the calling thread. \n
+  global() is the shared pool used by the library; its worker count is taken
+  from MICROGRAD_NUM_THREADS (total threads including the caller) and
+  defaults to one less than the hardware concurrency.
+**/
+class ThreadPool {
+ public:
+  using Task = std::function<void()>;
+
+  explicit ThreadPool(size_t num_workers = default_workers());
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool(ThreadPool &&) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ThreadPool &operator=(ThreadPool &&) = delete;
+
+  static ThreadPool &global();
+  static size_t default_workers();
+
+  [[nodiscard]] size_t num_workers() const noexcept { return workers_.size(); }
+
+  /* Run func asynchronously. Use wait() rather than future.get() from inside
+   * a task, so the blocked worker keeps executing queued work. */
+  template <class Func>
+  auto submit(Func &&func) -> std::future<std::invoke_result_t<Func>> {
+    using Result = std::invoke_result_t<Func>;
+    auto task = std::make_shared<std::packaged_task<Result()>>(
+        std::forward<Func>(func));
+    auto future = task->get_future();
+    if (workers_.empty()) {
+      (*task)();
+    } else {
+      push([task] { (*task)(); });
+    }
+    return future;
+  }
+
+  template <typename Result>
+  Result wait(std::future<Result> &future) {
+    while (future.wait_for(std::chrono::seconds(0))!=
+        std::future_status::ready) {
+      if (!run_one()) std::this_thread::yield();
+    }
+    return future.get();
+  }
+
+  /* Calls body(lo, hi) over disjoint chunks covering [begin, end), each at
+   * least grain long (except the last), and returns once all have run. The
+   * calling thread takes the first chunk. The first exception thrown by a
+   * chunk is rethrown here after the others have finished. */
+  template <class Func>
+  void parallel_for(const size_t begin, const size_t end, Func &&body,
+                    const size_t grain = 1) {
+    if (begin >= end) return;
+    const size_t n = end - begin;
+    const size_t max_chunks = (num_workers() + 1)*CHUNKS_PER_THREAD;
+    const size_t chunk = std::max({grain, (n + max_chunks - 1)/max_chunks,
+                                   static_cast<size_t>(1)});
+    const size_t chunks = (n + chunk - 1)/chunk;
+    if (chunks==1 || workers_.empty()) {
+      body(begin, end);
+      return;
+    }
+
+    Group group;
+    group.pending.store(chunks - 1, std::memory_order_relaxed);
+    for (size_t c = 1; c < chunks; c++) {
+      const size_t lo = begin + c*chunk;
+      const size_t hi = std::min(end, lo + chunk);
+      push([&group, &body, lo, hi] {
+        group.run([&] { body(lo, hi); });
+        group.pending.fetch_sub(1, std::memory_order_release);
+      });
+    }
+    group.run([&] { body(begin, begin + chunk); });
+    while (group.pending.load(std::memory_order_acquire)!=0) {
+      if (!run_one()) std::this_thread::yield();
+    }
+    if (group.error) std::rethrow_exception(group.error);
+  }
+
+  /* One entry per worker. Tasks run by threads outside the pool while they
+   * wait are counted by external_stats(). */
+  [[nodiscard]] std::vector<WorkerStats> stats() const;
+  [[nodiscard]] WorkerStats external_stats() const;
+  void reset_stats() noexcept;
+
+ private:
+  static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+  struct Counters {
+    std::atomic<uint64_t> tasks_run{0};
+    std::atomic<uint64_t> steals{0};
+    std::atomic<int64_t> idle_ns{0};
+    [[nodiscard]] WorkerStats load() const noexcept;
+    void reset() noexcept;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+    Counters counters;
+  };
+
+  /* Completion state of one parallel_for */
+  struct Group {
+    std::atomic<size_t> pending{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    template <class Func>
+    void run(Func &&func) noexcept {
+      try {
+        func();
+      } catch (...) {
+        std::lock_guard lock(error_mutex);
+        if (!error) error = std::current_exception();
+      }
+    }
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  Counters external_;
+  std::atomic<size_t> queued_{0};
+  std::atomic<size_t> next_victim_{0};  // round-robin target of push()
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stop_{false};
+
+  void push(Task task);
+  bool pop(size_t worker, Task &task);
+  bool steal(size_t thief, Task &task);
+  /* Run one queued task on the calling thread, false if none was found */
+  bool run_one();
+  void work(size_t id);
+};
+
+#endif //THREAD_POOL_HPP
@@ -1,10 +1,13 @@
 #ifndef INCLUDE_TRAINER_HPP_
 #define INCLUDE_TRAINER_HPP_
 
+#include <span>
 #include <vector>
+#include "batch_sampler.hpp"
 #include "components.hpp"
 #include "losses.hpp"
 #include "optimiser.hpp"
+#include "prefetcher.hpp"
 
 template <typename T, class Loss, class Optimiser>
 void train_batched_dataset(const std::shared_ptr<const MLP<T>> &model,
@@ -14,7 +17,8 @@ void train_batched_dataset(const std::shared_ptr<const MLP<T>> &model,
                            const std::vector<typename Loss::target_type> &eval_tgts,
                            Loss &loss,
                            Optimiser &optimiser,
-                           const size_t epochs) {
+                           const size_t epochs,
+                           const size_t micro_batch = 0) {
 
   const auto num_batches = batched_img_ds.size();
   for (size_t e = 0; e < epochs; e++) {
@@ -22,7 +26,8 @@ void train_batched_dataset(const std::shared_ptr<const MLP<T>> &model,
     std::cout << "Epoch " << e+1 << '/' << epochs <<'\n';
     double epoch_loss = 0;
     for (size_t i = 0; i < num_batches; i++) {
-      train_single_batch(model, batched_img_ds[i], batched_tgt_ds[i], loss, optimiser);
+      train_single_batch(model, batched_img_ds[i], batched_tgt_ds[i], loss, optimiser,
+                         micro_batch);
       epoch_loss += loss.get();
       loss.zero();
       std::cout << "Batch " << i+1 << '/' << num_batches << ", ";
@@ -32,14 +37,144 @@ void train_batched_dataset(const std::shared_ptr<const MLP<T>> &model,
   }
 }
 
+/* The same over batches that point into dataset storage, see BatchView */
+template <typename T, class Loss, class Optimiser>
+void train_batched_dataset(const std::shared_ptr<const MLP<T>> &model,
+                           std::span<const BatchView> batches,
+                           const BatchView &eval,
+                           Loss &loss,
+                           Optimiser &optimiser,
+                           const size_t epochs,
+                           const size_t micro_batch = 0) {
+
+  const auto num_batches = batches.size();
+  for (size_t e = 0; e < epochs; e++) {
+    std::cout << "============ Training ============\n";
+    std::cout << "Epoch " << e+1 << '/' << epochs <<'\n';
+    double epoch_loss = 0;
+    for (size_t i = 0; i < num_batches; i++) {
+      train_single_batch(model, batches[i], loss, optimiser, micro_batch);
+      epoch_loss += loss.get();
+      loss.zero();
+      std::cout << "Batch " << i+1 << '/' << num_batches << ", ";
+      evaluate_model(model, eval);
+    }
+    std::cout << "Epoch loss" << ": " << epoch_loss/num_batches << '\n';
+  }
+}
+
+/* A fresh order every epoch, see BatchSampler::set_epoch */
+template <typename T, class Loss, class Optimiser>
+void train_batched_dataset(const std::shared_ptr<const MLP<T>> &model,
+                           BatchSampler &sampler,
+                           const BatchView &eval,
+                           Loss &loss,
+                           Optimiser &optimiser,
+                           const size_t epochs,
+                           const size_t micro_batch = 0) {
+
+  for (size_t e = 0; e < epochs; e++) {
+    sampler.set_epoch(e);
+    const auto num_batches = sampler.num_batches();
+    std::cout << "============ Training ============\n";
+    std::cout << "Epoch " << e+1 << '/' << epochs <<'\n';
+    double epoch_loss = 0;
+    for (size_t i = 0; i < num_batches; i++) {
+      train_single_batch(model, sampler.batch(i), loss, optimiser,
+                         micro_batch);
+      epoch_loss += loss.get();
+      loss.zero();
+      std::cout << "Batch " << i+1 << '/' << num_batches << ", ";
+      evaluate_model(model, eval);
+    }
+    std::cout << "Epoch loss" << ": " << epoch_loss/num_batches << '\n';
+  }
+}
+
+/* The same with the batches prepared ahead by prefetcher's workers while
+ * the current one trains. Prints the pipeline's stats for each epoch. */
+template <typename T, class Loss, class Optimiser>
+void train_batched_dataset(const std::shared_ptr<const MLP<T>> &model,
+                           BatchSampler &sampler,
+                           Prefetcher<T> &prefetcher,
+                           const BatchView &eval,
+                           Loss &loss,
+                           Optimiser &optimiser,
+                           const size_t epochs,
+                           const size_t micro_batch = 0) {
+  for (size_t e = 0; e < epochs; e++) {
+    prefetcher.reset();
+    prefetcher.reset_stats();
+    sampler.set_epoch(e);
+    const auto num_batches = sampler.num_batches();
+    prefetcher.start(num_batches, [&sampler](const size_t i) {
+      return sampler.batch(i);
+    });
+    std::cout << "============ Training ============\n";
+    std::cout << "Epoch " << e+1 << '/' << epochs <<'\n';
+    double epoch_loss = 0;
+    while (const auto *batch = prefetcher.next()) {
+      train_single_batch(model, *batch, loss, optimiser, micro_batch);
+      epoch_loss += loss.get();
+      loss.zero();
+      std::cout << "Batch " << batch->index+1 << '/' << num_batches << ", ";
+      evaluate_model(model, eval);
+    }
+    std::cout << "Epoch loss" << ": " << epoch_loss/num_batches << '\n';
+    std::cout << prefetcher.stats() << '\n';
+  }
+}
+
+/* micro_batch > 0 streams the batch through forward and backward that many
+ * samples at a time (see Loss::stream_backward), bounding the size of the
+ * graph independently of the batch size. 0 records the whole batch. */
 template <typename T, class Loss, class Optimiser>
 void train_single_batch(const std::shared_ptr<const MLP<T>> &model,
                         const typename Loss::batched_input_type &img_batch,
                         const typename Loss::batched_target_type &tgt_batch,
                         Loss &loss,
-                        Optimiser &optimiser) {
-  loss.compute_loss(img_batch, tgt_batch);
-  loss.backward();
+                        Optimiser &optimiser,
+                        const size_t micro_batch = 0) {
+  if (micro_batch > 0) {
+    loss.stream_backward(img_batch, tgt_batch, micro_batch);
+  } else {
+    loss.compute_loss(img_batch, tgt_batch);
+    loss.backward();
+  }
+  optimiser.step();
+  model->zero_grad();
+}
+
+template <typename T, class Loss, class Optimiser>
+void train_single_batch(const std::shared_ptr<const MLP<T>> &model,
+                        const BatchView &batch,
+                        Loss &loss,
+                        Optimiser &optimiser,
+                        const size_t micro_batch = 0) {
+  if (micro_batch > 0) {
+    loss.stream_backward(batch, micro_batch);
+  } else {
+    loss.compute_loss(batch);
+    loss.backward();
+  }
+  optimiser.step();
+  model->zero_grad();
+}
+
+template <typename T, class Loss, class Optimiser>
+void train_single_batch(const std::shared_ptr<const MLP<T>> &model,
+                        const PreparedBatch<T> &batch,
+                        Loss &loss,
+                        Optimiser &optimiser,
+                        const size_t micro_batch = 0) {
+  if (micro_batch > 0) {
+    loss.stream_backward(batch.inputs.data(), batch.cols, batch.labels,
+                         micro_batch);
+  } else {
+    loss.compute_loss(TensorValue<T>::input(batch.inputs.data(), batch.rows,
+                                            batch.cols), batch.labels);
+    loss.backward();
+  }
   optimiser.step();
   model->zero_grad();
 }
@@ -91,17 +226,14 @@ template <typename T>
 void evaluate_model(const std::shared_ptr<const MLP<T>> &model,
                     const std::vector<std::vector<T>> &eval_imgs,
                     const std::vector<uint8_t> &eval_tgts) {
-  std::vector<uint8_t> preds;
-  preds.reserve(eval_tgts.size());
-  for (const auto &img : eval_imgs) {
-    preds.emplace_back(model->predict(img));
-  }
+  const auto result = model->predict_batch(eval_imgs, eval_tgts);
+  std::cout << "Accuracy = " << result.accuracy << '\n';
+}
 
-  double correct = 0;
-  for (size_t i = 0; i < eval_tgts.size(); i++) {
-    if (preds[i] == eval_tgts[i]) correct++;
-  }
-  std::cout << "Accuracy = " << correct/eval_imgs.size() << '\n';
+template <typename T>
+void evaluate_model(const std::shared_ptr<const MLP<T>> &model,
+                    const BatchView &eval) {
+  std::cout << "Accuracy = " << model->predict_batch(eval).accuracy << '\n';
 }
 
 #endif //INCLUDE_TRAINER_HPP_
@@ -1,37 +1,46 @@
 #include <string>
 #include <vector>
-#include <tuple>
 #include <iostream>
+#include <random>
+#include "include/batch_sampler.hpp"
+#include "include/batch_view.hpp"
 #include "include/components.hpp"
-#include "include/data_handler.hpp"
+#include "include/distributed.hpp"
+#include "include/idx_dataset.hpp"
 #include "include/losses.hpp"
 #include "include/optimiser.hpp"
+#include "include/prefetcher.hpp"
 #include "include/trainer.hpp"
 
 constexpr size_t batch_size = 100;
 constexpr size_t epochs = 1;
 constexpr double learning_rate = 1e-3;
+constexpr uint32_t split_seed = 42;  // shared by the ranks of a distributed run
 
 int main() {
 
   const std::string image_file{"data/t10k-images-idx3-ubyte"};
   const std::string label_file{"data/t10k-labels-idx1-ubyte"};
 
-  const auto dh{DataHandler(image_file, label_file)};
-  const size_t image_size = dh.get_image_size();
-  const size_t num_classes = dh.num_classes();
-  const auto batched_training_data{dh.get_batched_training_data(batch_size)};
-  const auto validation_data{dh.get_validation_data()};
+  /* MICROGRAD_RANK / MICROGRAD_WORLD_SIZE select a rank of a multi-process
+   * run, see ProcessGroup */
+  auto group = ProcessGroup::from_env();
+  const bool distributed = group.world_size() > 1;
 
-  std::vector<std::vector<image_t>> batched_training_images;
-  std::vector<std::vector<label_t>> batched_training_targets;
-  std::vector<image_t> validation_images;
-  std::vector<label_t> validation_targets;
+  /* The images stay in the mapped files; batches are views into them and
+   * are only converted to double as they are loaded into the tape */
+  const IdxDataset dataset(image_file, label_file);
+  const size_t image_size = dataset.image_size();
+  const size_t num_classes = dataset.num_classes();
+  /* the split and the per-epoch batch order */
+  const uint32_t seed = distributed ? split_seed : std::random_device{}();
+  const auto split = dataset.split(seed);
+  std::cout << "Training size: " << split.training.size() << '\n';
+  std::cout << "Validation size: " << split.validation.size() << '\n';
+  std::cout << "Test size: " << split.test.size() << '\n';
 
-  std::tie(batched_training_images,
-           batched_training_targets) = extract(batched_training_data);
-  std::tie(validation_images,
-           validation_targets) = extract(validation_data);
+  BatchSampler sampler(dataset, split.training, batch_size, seed);
+  const BatchView validation(dataset, split.validation);
 
   const MLP<double> model({
                               Layer<double>{image_size, 32, UnaryOp::relu},
@@ -40,13 +49,25 @@ int main() {
   const std::shared_ptr<const MLP<double>>
       mp = std::make_shared<MLP<double>>(model);
   auto adam{Adam<double>(mp, learning_rate)};
+  if (distributed) {
+    DistributedDataParallel<double, SparseCCELoss<double>> trainer(mp, group);
+    train_batched_dataset(trainer,
+                          mp,
+                          sampler,
+                          validation,
+                          adam,
+                          epochs);
+    if (group.rank()==0) std::cout << "Done\n";
+    return 0;
+  }
   auto loss{SparseCCELoss<double>(mp)};
+  /* the next batches are gathered while the current one trains */
+  Prefetcher<double> prefetcher;
 
   train_batched_dataset(mp,
-                        batched_training_images,
-                        batched_training_targets,
-                        validation_images,
-                        validation_targets,
+                        sampler,
+                        prefetcher,
+                        validation,
                         loss,
                         adam,
                         epochs);
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include "../include/batch_sampler.hpp"
+
+BatchSampler::BatchSampler(const uint8_t *images,
+                           const std::span<const uint8_t> labels,
+                           const size_t image_size,
+                           std::vector<size_t> indices,
+                           const size_t batch_size,
+                           const uint32_t seed,
+                           const Sampling sampling,
+                           std::vector<double> class_weights)
+    : images_(images), labels_(labels), image_size_(image_size),
+      indices_(std::move(indices)), class_weights_(std::move(class_weights)),
+      batch_size_(batch_size), seed_(seed), sampling_(sampling) {
+  if (batch_size_==0)
+    throw std::invalid_argument("BatchSampler expects a non-zero batch size.");
+  for (const auto i : indices_) {
+    if (i >= labels_.size())
+      throw std::out_of_range("BatchSampler index past the end of the dataset.");
+    const auto label = labels_[i];
+    if (label >= by_class_.size()) by_class_.resize(label + 1);
+    by_class_[label].emplace_back(i);
+  }
+
+  if (sampling_==Sampling::weighted) {
+    if (class_weights_.empty()) {
+      for (const auto &members : by_class_) {
+        class_weights_.emplace_back(
+            members.empty() ? 0.0 : 1.0/static_cast<double>(members.size()));
+      }
+    }
+    if (class_weights_.size() < by_class_.size()) {
+      throw std::invalid_argument("BatchSampler needs a weight for each of the "
+                                  + std::to_string(by_class_.size())
+                                  + " classes.");
+    }
+    class_weights_.resize(by_class_.size());
+    /* a class without samples can't be drawn */
+    double total = 0;
+    for (size_t c = 0; c < by_class_.size(); c++) {
+      if (class_weights_[c] < 0)
+        throw std::invalid_argument("BatchSampler weights must be >= 0.");
+      if (by_class_[c].empty()) class_weights_[c] = 0;
+      total += class_weights_[c];
+    }
+    if (total==0 && !indices_.empty())
+      throw std::invalid_argument("BatchSampler weights are all zero.");
+  }
+  set_epoch(0);
+}
+
+BatchSampler::BatchSampler(const IdxDataset &dataset,
+                           std::vector<size_t> indices,
+                           const size_t batch_size,
+                           const uint32_t seed,
+                           const Sampling sampling,
+                           std::vector<double> class_weights)
+    : BatchSampler(dataset.images().data(), dataset.labels(),
+                   dataset.image_size(), std::move(indices), batch_size, seed,
+                   sampling, std::move(class_weights)) {}
+
+/* The order depends only on (seed, epoch), not on the epochs before */
+void BatchSampler::set_epoch(const size_t epoch) {
+  epoch_ = epoch;
+  std::seed_seq seq{seed_, static_cast<uint32_t>(epoch),
+                    static_cast<uint32_t>(epoch >> 32)};
+  std::mt19937 gen(seq);
+  switch (sampling_) {
+    case Sampling::shuffle: shuffle(gen);
+      break;
+    case Sampling::stratified: stratify(gen);
+      break;
+    case Sampling::weighted: draw_weighted(gen);
+      break;
+  }
+}
+
+void BatchSampler::shuffle(std::mt19937 &gen) {
+  order_.assign(indices_.begin(), indices_.end());
+  std::ranges::shuffle(order_, gen);
+}
+
+/* Each class is shuffled on its own, then the classes are interleaved: the
+ * j-th sample of class c (of n_c) goes at about position (j + u_c)/n_c of
+ * the epoch, u_c a random phase. Any run of b samples then holds
+ * b·n_c/n ± 1 of class c. */
+void BatchSampler::stratify(std::mt19937 &gen) {
+  constexpr double done = std::numeric_limits<double>::infinity();
+  const size_t classes = by_class_.size();
+  std::vector<std::vector<size_t>> strata(by_class_);
+  std::vector<size_t> next(classes, 0);
+  std::vector<double> phase(classes);
+  std::vector<double> key(classes, done);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  const auto position = [&](const size_t c) {
+    return next[c] < strata[c].size()
+           ? (static_cast<double>(next[c]) + phase[c])/
+               static_cast<double>(strata[c].size())
+           : done;
+  };
+  for (size_t c = 0; c < classes; c++) {
+    std::ranges::shuffle(strata[c], gen);
+    phase[c] = uniform(gen);
+    key[c] = position(c);
+  }
+
+  order_.clear();
+  for (size_t i = 0; i < indices_.size(); i++) {
+    const auto c = static_cast<size_t>(
+        std::distance(key.begin(), std::ranges::min_element(key)));
+    order_.emplace_back(strata[c][next[c]++]);
+    key[c] = position(c);
+  }
+}
+
+void BatchSampler::draw_weighted(std::mt19937 &gen) {
+  /* a class is drawn in proportion to its total weight */
+  std::vector<double> class_mass(by_class_.size());
+  for (size_t c = 0; c < by_class_.size(); c++)
+    class_mass[c] = class_weights_[c]*static_cast<double>(by_class_[c].size());
+  std::discrete_distribution<size_t> pick_class(class_mass.begin(),
+                                                class_mass.end());
+  order_.clear();
+  for (size_t i = 0; i < indices_.size(); i++) {
+    const auto &members = by_class_[pick_class(gen)];
+    std::uniform_int_distribution<size_t> pick(0, members.size() - 1);
+    order_.emplace_back(members[pick(gen)]);
+  }
+}
+
+std::vector<size_t> BatchSampler::class_counts() const {
+  std::vector<size_t> counts;
+  counts.reserve(by_class_.size());
+  for (const auto &members : by_class_) counts.emplace_back(members.size());
+  return counts;
+}
+
+BatchView BatchSampler::batch(const size_t i) const {
+  if (i >= num_batches())
+    throw std::out_of_range("BatchSampler::batch out of range.");
+  const size_t lo = i*batch_size_;
+  const size_t hi = std::min(order_.size(), lo + batch_size_);
+  return {images_, labels_.data(), image_size_,
+          std::span<const size_t>(order_).subspan(lo, hi - lo)};
+}
@@ -4,7 +4,7 @@
 #include <random>
 #include "../include/data_handler.hpp"
 
-DataHandler::DataHandler() {
+DataHandler::DataHandler() : split_seed_(std::random_device{}()) {
   data_array_ = new std::vector<Data *>;
   training_data_ = new std::vector<Data *>;
   validation_data_ = new std::vector<Data *>;
@@ -13,7 +13,13 @@ DataHandler::DataHandler() {
 
 [[maybe_unused]] DataHandler::DataHandler(const std::string &image_path,
                          const std::string &label_path)
+    : DataHandler(image_path, label_path, std::random_device{}()) {}
+
+DataHandler::DataHandler(const std::string &image_path,
+                         const std::string &label_path,
+                         const uint32_t split_seed)
     : DataHandler() {
+  split_seed_ = split_seed;
   read_feature_vector(image_path);
   read_feature_labels(label_path);
   normalise_data();
@@ -103,8 +109,7 @@ void DataHandler::split_data() const {
   std::vector<size_t> indices(total_length_);
   std::iota(indices.begin(), indices.end(), 0);
 
-  std::random_device rd;
-  std::mt19937 g(rd());
+  std::mt19937 g(split_seed_);
   std::ranges::shuffle(indices, g);
 
   const std::vector<size_t> train_indices(
@@ -183,6 +188,25 @@ DataHandler::get_batched_training_data(const size_t batch_size) const {
   return batch_dataset(training_data_, batch_size);
 }
 
+/* Rank r keeps samples [n·r/W, n·(r+1)/W) of every n-sample batch, so the
+ * ranks step through the same batches together */
+std::vector<std::vector<Data *>>
+DataHandler::get_batched_training_shard(const size_t batch_size,
+                                        const size_t rank,
+                                        const size_t world_size) const {
+  if (rank >= world_size) {
+    throw std::invalid_argument("Rank out of range for the world size.");
+  }
+  auto batches = batch_dataset(training_data_, batch_size);
+  for (auto &batch : batches) {
+    const size_t n = batch.size();
+    batch = std::vector<Data *>(
+        batch.begin() + static_cast<long>(n*rank/world_size),
+        batch.begin() + static_cast<long>(n*(rank + 1)/world_size));
+  }
+  return batches;
+}
+
 std::vector<std::vector<Data *>>
 DataHandler::get_batched_validation_data(const size_t batch_size) const {
   return batch_dataset(validation_data_, batch_size);
@@ -208,21 +232,25 @@ void DataHandler::print_class_info() const {
   }
 }
 
-std::tuple<image_t, label_t>
+template <typename T>
+std::tuple<image_type<T>, label_t>
 extract(const Data *d) {
-  return std::make_tuple(*d->get_feature_vector(), d->get_label());
+  const auto *features = d->get_feature_vector();
+  return std::make_tuple(image_type<T>(features->begin(), features->end()),
+                         d->get_label());
 }
 
-std::tuple<std::vector<image_t>, std::vector<label_t>>
+template <typename T>
+std::tuple<std::vector<image_type<T>>, std::vector<label_t>>
 extract(const data_vec_t *data) {
-  std::vector<image_t> inputs;
+  std::vector<image_type<T>> inputs;
   std::vector<label_t> targets;
   inputs.reserve(data->size());
   targets.reserve(data->size());
 
   for (const auto d : *data) {
     if (d) {
-      auto [img, lbl] = extract(d);
+      auto [img, lbl] = extract<T>(d);
       inputs.push_back(std::move(img));
       targets.push_back(lbl);
     }
@@ -230,17 +258,34 @@ extract(const data_vec_t *data) {
   return std::make_tuple(std::move(inputs), std::move(targets));
 }
 
-std::tuple<std::vector<std::vector<image_t>>, std::vector<std::vector<label_t>>>
+template <typename T>
+std::tuple<std::vector<std::vector<image_type<T>>>,
+           std::vector<std::vector<label_t>>>
 extract(const data_batch_t &batched_data) {
-  std::vector<std::vector<image_t>> img_batch;
+  std::vector<std::vector<image_type<T>>> img_batch;
   std::vector<std::vector<label_t>> lbl_batch;
   img_batch.reserve(batched_data.size());
   lbl_batch.reserve(batched_data.size());
 
   for (const auto &data_vec : batched_data) {
-    auto [imgs, lbls] = extract(&data_vec);
+    auto [imgs, lbls] = extract<T>(&data_vec);
     img_batch.push_back(std::move(imgs));
     lbl_batch.push_back(std::move(lbls));
   }
   return std::make_tuple(std::move(img_batch), std::move(lbl_batch));
 }
+
+template std::tuple<image_type<double>, label_t>
+extract<double>(const Data *);
+template std::tuple<image_type<float>, label_t>
+extract<float>(const Data *);
+template std::tuple<std::vector<image_type<double>>, std::vector<label_t>>
+extract<double>(const data_vec_t *);
+template std::tuple<std::vector<image_type<float>>, std::vector<label_t>>
+extract<float>(const data_vec_t *);
+template std::tuple<std::vector<std::vector<image_type<double>>>,
+                    std::vector<std::vector<label_t>>>
+extract<double>(const data_batch_t &);
+template std::tuple<std::vector<std::vector<image_type<float>>>,
+                    std::vector<std::vector<label_t>>>
+extract<float>(const data_batch_t &);
@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <atomic>
+#include "../include/aligned_allocator.hpp"
+#include "../include/gemm.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MICROGRAD_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/* Problems below this many multiply-adds, or with a side shorter than a
+ * register tile, don't amortise the packing and use the plain loops */
+inline constexpr size_t SMALL_GEMM = 8192;
+inline constexpr size_t SMALL_GEMM_SIDE = 4;
+
+/*============================================================================*/
+/* Unpacked loops, ordered so the innermost loop runs with unit stride,
+ * except for Aᵀ·Bᵀ, where one operand is always read across its rows; the
+ * innermost loop walks B and steps through A by lda. No term is skipped,
+ * so 0·NaN and 0·Inf propagate as in the packed kernels. */
+template <typename T>
+void gemm_reference(const bool trans_a, const bool trans_b,
+                    const size_t m, const size_t n, const size_t k,
+                    const T *a, const size_t lda,
+                    const T *b, const size_t ldb,
+                    T *c, const size_t ldc) {
+  if (!trans_a && !trans_b) {
+    for (size_t i = 0; i < m; i++) {
+      T *c_row = c + i*ldc;
+      for (size_t p = 0; p < k; p++) {
+        const T a_ip = a[i*lda + p];
+        const T *b_row = b + p*ldb;
+        for (size_t j = 0; j < n; j++) c_row[j] += a_ip*b_row[j];
+      }
+    }
+  } else if (!trans_a) {
+    for (size_t i = 0; i < m; i++) {
+      const T *a_row = a + i*lda;
+      for (size_t j = 0; j < n; j++) {
+        const T *b_row = b + j*ldb;
+        T sum = 0;
+        for (size_t p = 0; p < k; p++) sum += a_row[p]*b_row[p];
+        c[i*ldc + j] += sum;
+      }
+    }
+  } else if (!trans_b) {
+    for (size_t p = 0; p < k; p++) {
+      const T *a_row = a + p*lda;
+      const T *b_row = b + p*ldb;
+      for (size_t i = 0; i < m; i++) {
+        const T a_pi = a_row[i];
+        T *c_row = c + i*ldc;
+        for (size_t j = 0; j < n; j++) c_row[j] += a_pi*b_row[j];
+      }
+    }
+  } else {
+    for (size_t i = 0; i < m; i++) {
+      for (size_t j = 0; j < n; j++) {
+        T sum = 0;
+        for (size_t p = 0; p < k; p++) sum += a[p*lda + i]*b[j*ldb + p];
+        c[i*ldc + j] += sum;
+      }
+    }
+  }
+}
+
+/*============================================================================*/
+/* Micro-kernels: C[MR x NR] += A_panel·B_panel over kc, where the packed A
+ * panel holds MR values per k and the packed B panel NR values per k */
+template <typename T>
+using kernel_fn = void (*)(size_t, const T *, const T *, T *, size_t);
+
+template <typename T, size_t MR, size_t NR>
+void kernel_scalar(const size_t kc, const T *a, const T *b,
+                   T *c, const size_t ldc) {
+  T acc[MR][NR] = {};
+  for (size_t p = 0; p < kc; p++, a += MR, b += NR) {
+    for (size_t r = 0; r < MR; r++)
+      for (size_t j = 0; j < NR; j++) acc[r][j] += a[r]*b[j];
+  }
+  for (size_t r = 0; r < MR; r++)
+    for (size_t j = 0; j < NR; j++) c[r*ldc + j] += acc[r][j];
+}
+
+#ifdef MICROGRAD_X86_KERNELS
+/* 6 x 8 doubles: 12 ymm accumulators */
+__attribute__((target("avx2,fma")))
+void kernel_avx2(const size_t kc, const double *a, const double *b,
+                 double *c, const size_t ldc) {
+  constexpr size_t MR = 6;
+  __m256d acc[MR][2];
+#pragma GCC unroll 6
+  for (size_t r = 0; r < MR; r++)
+    acc[r][0] = acc[r][1] = _mm256_setzero_pd();
+  for (size_t p = 0; p < kc; p++, a += MR, b += 8) {
+    const __m256d b0 = _mm256_load_pd(b);
+    const __m256d b1 = _mm256_load_pd(b + 4);
+#pragma GCC unroll 6
+    for (size_t r = 0; r < MR; r++) {
+      const __m256d ar = _mm256_broadcast_sd(a + r);
+      acc[r][0] = _mm256_fmadd_pd(ar, b0, acc[r][0]);
+      acc[r][1] = _mm256_fmadd_pd(ar, b1, acc[r][1]);
+    }
+  }
+#pragma GCC unroll 6
+  for (size_t r = 0; r < MR; r++) {
+    double *row = c + r*ldc;
+    _mm256_storeu_pd(row, _mm256_add_pd(_mm256_loadu_pd(row), acc[r][0]));
+    _mm256_storeu_pd(row + 4,
+                     _mm256_add_pd(_mm256_loadu_pd(row + 4), acc[r][1]));
+  }
+}
+
+/* 6 x 16 floats: 12 ymm accumulators */
+__attribute__((target("avx2,fma")))
+void kernel_avx2(const size_t kc, const float *a, const float *b,
+                 float *c, const size_t ldc) {
+  constexpr size_t MR = 6;
+  __m256 acc[MR][2];
+#pragma GCC unroll 6
+  for (size_t r = 0; r < MR; r++)
+    acc[r][0] = acc[r][1] = _mm256_setzero_ps();
+  for (size_t p = 0; p < kc; p++, a += MR, b += 16) {
+    const __m256 b0 = _mm256_load_ps(b);
+    const __m256 b1 = _mm256_load_ps(b + 8);
+#pragma GCC unroll 6
+    for (size_t r = 0; r < MR; r++) {
+      const __m256 ar = _mm256_broadcast_ss(a + r);
+      acc[r][0] = _mm256_fmadd_ps(ar, b0, acc[r][0]);
+      acc[r][1] = _mm256_fmadd_ps(ar, b1, acc[r][1]);
+    }
+  }
+#pragma GCC unroll 6
+  for (size_t r = 0; r < MR; r++) {
+    float *row = c + r*ldc;
+    _mm256_storeu_ps(row, _mm256_add_ps(_mm256_loadu_ps(row), acc[r][0]));
+    _mm256_storeu_ps(row + 8,
+                     _mm256_add_ps(_mm256_loadu_ps(row + 8), acc[r][1]));
+  }
+}
+
+/* 12 x 16 doubles: 24 zmm accumulators */
+__attribute__((target("avx512f")))
+void kernel_avx512(const size_t kc, const double *a, const double *b,
+                   double *c, const size_t ldc) {
+  constexpr size_t MR = 12;
+  __m512d acc[MR][2];
+#pragma GCC unroll 12
+  for (size_t r = 0; r < MR; r++)
+    acc[r][0] = acc[r][1] = _mm512_setzero_pd();
+  for (size_t p = 0; p < kc; p++, a += MR, b += 16) {
+    const __m512d b0 = _mm512_load_pd(b);
+    const __m512d b1 = _mm512_load_pd(b + 8);
+#pragma GCC unroll 12
+    for (size_t r = 0; r < MR; r++) {
+      const __m512d ar = _mm512_set1_pd(a[r]);
+      acc[r][0] = _mm512_fmadd_pd(ar, b0, acc[r][0]);
+      acc[r][1] = _mm512_fmadd_pd(ar, b1, acc[r][1]);
+    }
+  }
+#pragma GCC unroll 12
+  for (size_t r = 0; r < MR; r++) {
+    double *row = c + r*ldc;
+    _mm512_storeu_pd(row, _mm512_add_pd(_mm512_loadu_pd(row), acc[r][0]));
+    _mm512_storeu_pd(row + 8,
+                     _mm512_add_pd(_mm512_loadu_pd(row + 8), acc[r][1]));
+  }
+}
+
+/* 12 x 32 floats: 24 zmm accumulators */
+__attribute__((target("avx512f")))
+void kernel_avx512(const size_t kc, const float *a, const float *b,
+                   float *c, const size_t ldc) {
+  constexpr size_t MR = 12;
+  __m512 acc[MR][2];
+#pragma GCC unroll 12
+  for (size_t r = 0; r < MR; r++)
+    acc[r][0] = acc[r][1] = _mm512_setzero_ps();
+  for (size_t p = 0; p < kc; p++, a += MR, b += 32) {
+    const __m512 b0 = _mm512_load_ps(b);
+    const __m512 b1 = _mm512_load_ps(b + 16);
+#pragma GCC unroll 12
+    for (size_t r = 0; r < MR; r++) {
+      const __m512 ar = _mm512_set1_ps(a[r]);
+      acc[r][0] = _mm512_fmadd_ps(ar, b0, acc[r][0]);
+      acc[r][1] = _mm512_fmadd_ps(ar, b1, acc[r][1]);
+    }
+  }
+#pragma GCC unroll 12
+  for (size_t r = 0; r < MR; r++) {
+    float *row = c + r*ldc;
+    _mm512_storeu_ps(row, _mm512_add_ps(_mm512_loadu_ps(row), acc[r][0]));
+    _mm512_storeu_ps(row + 16,
+                     _mm512_add_ps(_mm512_loadu_ps(row + 16), acc[r][1]));
+  }
+}
+#endif
+
+/*============================================================================*/
+/* Register tile (MR x NR) and cache blocks: a KC x NC panel of B stays in
+ * L3, an MC x KC block of A in L2 and a KC x NR sliver of B in L1 */
+template <typename T>
+struct KernelConfig {
+  kernel_fn<T> kernel;
+  size_t mr;
+  size_t nr;
+  size_t mc;
+  size_t kc;
+  size_t nc;
+};
+
+template <typename T>
+KernelConfig<T> kernel_config(const GemmIsa isa) {
+  constexpr bool is_double = sizeof(T)==sizeof(double);
+  switch (isa) {
+#ifdef MICROGRAD_X86_KERNELS
+    case GemmIsa::avx512:
+      return {&kernel_avx512, 12, is_double ? 16u : 32u, 144, 256, 4096};
+    case GemmIsa::avx2:
+      return {&kernel_avx2, 6, is_double ? 8u : 16u, 72, 256, 4096};
+#endif
+    default:return {&kernel_scalar<T, 4, 4>, 4, 4, 64, 256, 4096};
+  }
+}
+
+/* op(A)[i0:i0+mc, p0:p0+kc] into MR-row panels, zero padded */
+template <typename T>
+void pack_a(const bool trans, const T *a, const size_t lda,
+            const size_t i0, const size_t mc,
+            const size_t p0, const size_t kc,
+            const size_t mr, T *pack) {
+  for (size_t ir = 0; ir < mc; ir += mr) {
+    const size_t rows = std::min(mr, mc - ir);
+    for (size_t p = 0; p < kc; p++, pack += mr) {
+      for (size_t r = 0; r < rows; r++) {
+        const size_t i = i0 + ir + r;
+        pack[r] = trans ? a[(p0 + p)*lda + i] : a[i*lda + p0 + p];
+      }
+      std::fill(pack + rows, pack + mr, static_cast<T>(0));
+    }
+  }
+}
+
+/* op(B)[p0:p0+kc, j0:j0+nc] into NR-column panels, zero padded */
+template <typename T>
+void pack_b(const bool trans, const T *b, const size_t ldb,
+            const size_t p0, const size_t kc,
+            const size_t j0, const size_t nc,
+            const size_t nr, T *pack) {
+  for (size_t jr = 0; jr < nc; jr += nr) {
+    const size_t cols = std::min(nr, nc - jr);
+    for (size_t p = 0; p < kc; p++, pack += nr) {
+      if (trans) {
+        for (size_t j = 0; j < cols; j++)
+          pack[j] = b[(j0 + jr + j)*ldb + p0 + p];
+      } else {
+        const T *row = b + (p0 + p)*ldb + j0 + jr;
+        std::copy(row, row + cols, pack);
+      }
+      std::fill(pack + cols, pack + nr, static_cast<T>(0));
+    }
+  }
+}
+
+template <typename T>
+void gemm_packed(const KernelConfig<T> &cfg,
+                 const bool trans_a, const bool trans_b,
+                 const size_t m, const size_t n, const size_t k,
+                 const T *a, const size_t lda,
+                 const T *b, const size_t ldb,
+                 T *c, const size_t ldc) {
+  /* per thread, so concurrent callers don't share packing buffers */
+  thread_local aligned_vector<T> a_pack;
+  thread_local aligned_vector<T> b_pack;
+  thread_local aligned_vector<T> edge;
+  const auto [kernel, mr, nr, mc_max, kc_max, nc_max] = cfg;
+  a_pack.resize(((mc_max + mr - 1)/mr)*mr*kc_max);
+  b_pack.resize(((nc_max + nr - 1)/nr)*nr*kc_max);
+  edge.resize(mr*nr);
+
+  for (size_t jc = 0; jc < n; jc += nc_max) {
+    const size_t nc = std::min(nc_max, n - jc);
+    for (size_t pc = 0; pc < k; pc += kc_max) {
+      const size_t kc = std::min(kc_max, k - pc);
+      pack_b(trans_b, b, ldb, pc, kc, jc, nc, nr, b_pack.data());
+      for (size_t ic = 0; ic < m; ic += mc_max) {
+        const size_t mc = std::min(mc_max, m - ic);
+        pack_a(trans_a, a, lda, ic, mc, pc, kc, mr, a_pack.data());
+        for (size_t jr = 0; jr < nc; jr += nr) {
+          const size_t cols = std::min(nr, nc - jr);
+          const T *b_panel = b_pack.data() + jr*kc;
+          for (size_t ir = 0; ir < mc; ir += mr) {
+            const size_t rows = std::min(mr, mc - ir);
+            const T *a_panel = a_pack.data() + ir*kc;
+            T *c_tile = c + (ic + ir)*ldc + jc + jr;
+            if (rows==mr && cols==nr) {
+              kernel(kc, a_panel, b_panel, c_tile, ldc);
+              continue;
+            }
+            std::fill(edge.begin(), edge.end(), static_cast<T>(0));
+            kernel(kc, a_panel, b_panel, edge.data(), nr);
+            for (size_t r = 0; r < rows; r++)
+              for (size_t j = 0; j < cols; j++)
+                c_tile[r*ldc + j] += edge[r*nr + j];
+          }
+        }
+      }
+    }
+  }
+}
+
+/*============================================================================*/
+static GemmIsa best_supported_isa() noexcept {
+#ifdef MICROGRAD_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return GemmIsa::avx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return GemmIsa::avx2;
+#endif
+  return GemmIsa::scalar;
+}
+
+/* Atomic, as set_gemm_isa may run while pool threads are in gemm */
+static std::atomic<GemmIsa> &selected_isa() noexcept {
+  static std::atomic<GemmIsa> isa{best_supported_isa()};
+  return isa;
+}
+
+GemmIsa gemm_isa() noexcept {
+  return selected_isa().load(std::memory_order_relaxed);
+}
+
+GemmIsa set_gemm_isa(const GemmIsa isa) noexcept {
+  const auto best = best_supported_isa();
+  const auto chosen = static_cast<uint8_t>(isa) <= static_cast<uint8_t>(best)
+                      ? isa : best;
+  selected_isa().store(chosen, std::memory_order_relaxed);
+  return chosen;
+}
+
+const char *to_string(const GemmIsa isa) noexcept {
+  switch (isa) {
+    case GemmIsa::avx512:return "avx512";
+    case GemmIsa::avx2:return "avx2";
+    default:return "scalar";
+  }
+}
+
+template <typename T>
+void gemm(const bool trans_a, const bool trans_b,
+          const size_t m, const size_t n, const size_t k,
+          const T *a, const size_t lda,
+          const T *b, const size_t ldb,
+          T *c, const size_t ldc,
+          const bool accumulate) {
+  if (!accumulate) {
+    for (size_t i = 0; i < m; i++)
+      std::fill_n(c + i*ldc, n, static_cast<T>(0));
+  }
+  if (m*n*k < SMALL_GEMM || std::min(m, n) < SMALL_GEMM_SIDE) {
+    gemm_reference(trans_a, trans_b, m, n, k, a, lda, b, ldb, c, ldc);
+    return;
+  }
+  gemm_packed(kernel_config<T>(gemm_isa()),
+              trans_a, trans_b, m, n, k, a, lda, b, ldb, c, ldc);
+}
+
+template void gemm<double>(bool, bool, size_t, size_t, size_t,
+                           const double *, size_t, const double *, size_t,
+                           double *, size_t, bool);
+template void gemm<float>(bool, bool, size_t, size_t, size_t,
+                          const float *, size_t, const float *, size_t,
+                          float *, size_t, bool);
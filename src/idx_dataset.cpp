@@ -0,0 +1,153 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include "../include/idx_dataset.hpp"
+
+namespace {
+constexpr uint32_t IMAGE_MAGIC = 0x00000803;  // unsigned bytes, 3 dimensions
+constexpr uint32_t LABEL_MAGIC = 0x00000801;  // unsigned bytes, 1 dimension
+constexpr size_t IMAGE_HEADER = 16;
+constexpr size_t LABEL_HEADER = 8;
+
+/* Header fields are big endian */
+uint32_t read_u32(const uint8_t *p) noexcept {
+  return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+      static_cast<uint32_t>(p[2]) << 8 | static_cast<uint32_t>(p[3]);
+}
+}
+
+IdxDataset::Mapping IdxDataset::map(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open " + path + ": " +
+        std::strerror(errno));
+  }
+  struct stat info{};
+  if (::fstat(fd, &info) < 0 || info.st_size==0) {
+    ::close(fd);
+    throw std::runtime_error("Failed to read the size of " + path + ".");
+  }
+  const auto size = static_cast<size_t>(info.st_size);
+  void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data==MAP_FAILED) {
+    throw std::runtime_error("Failed to map " + path + ": " +
+        std::strerror(errno));
+  }
+  ::madvise(data, size, MADV_SEQUENTIAL);
+  return {static_cast<const uint8_t *>(data), size};
+}
+
+void IdxDataset::unmap(Mapping &mapping) noexcept {
+  if (mapping.data)
+    ::munmap(const_cast<uint8_t *>(mapping.data), mapping.size);
+  mapping = {};
+}
+
+IdxDataset::IdxDataset(const std::string &image_path,
+                       const std::string &label_path) {
+  image_file_ = map(image_path);
+  try {
+    label_file_ = map(label_path);
+    const uint8_t *images = image_file_.data;
+    const uint8_t *labels = label_file_.data;
+    if (image_file_.size < IMAGE_HEADER ||
+        read_u32(images)!=IMAGE_MAGIC) {
+      throw std::runtime_error(image_path + " is not an IDX image file.");
+    }
+    if (label_file_.size < LABEL_HEADER ||
+        read_u32(labels)!=LABEL_MAGIC) {
+      throw std::runtime_error(label_path + " is not an IDX label file.");
+    }
+    size_ = read_u32(images + 4);
+    rows_ = read_u32(images + 8);
+    cols_ = read_u32(images + 12);
+    if (read_u32(labels + 4)!=size_) {
+      throw std::runtime_error(
+          "The image and label files hold different numbers of samples.");
+    }
+    /* size_*rows_*cols_ can wrap, so the image count is checked by
+     * division; rows_*cols_ alone fits in 64 bits */
+    const size_t image_bytes = rows_*cols_;
+    const size_t body = image_file_.size - IMAGE_HEADER;
+    if (image_bytes==0 || body%image_bytes!=0 || body/image_bytes!=size_ ||
+        label_file_.size!=LABEL_HEADER + size_) {
+      throw std::runtime_error(
+          "The IDX file sizes don't match their headers.");
+    }
+    for (const auto l : this->labels()) {
+      if (l >= class_counts_.size()) class_counts_.resize(l + 1, 0);
+      ++class_counts_[l];
+    }
+  } catch (...) {
+    unmap(image_file_);
+    unmap(label_file_);
+    throw;
+  }
+}
+
+IdxDataset::~IdxDataset() {
+  unmap(image_file_);
+  unmap(label_file_);
+}
+
+IdxDataset::IdxDataset(IdxDataset &&other) noexcept
+    : image_file_(std::exchange(other.image_file_, {})),
+      label_file_(std::exchange(other.label_file_, {})),
+      size_(std::exchange(other.size_, 0)),
+      rows_(std::exchange(other.rows_, 0)),
+      cols_(std::exchange(other.cols_, 0)),
+      class_counts_(std::exchange(other.class_counts_, {})) {}
+
+IdxDataset &IdxDataset::operator=(IdxDataset &&other) noexcept {
+  if (this!=&other) {
+    unmap(image_file_);
+    unmap(label_file_);
+    image_file_ = std::exchange(other.image_file_, {});
+    label_file_ = std::exchange(other.label_file_, {});
+    size_ = std::exchange(other.size_, 0);
+    rows_ = std::exchange(other.rows_, 0);
+    cols_ = std::exchange(other.cols_, 0);
+    class_counts_ = std::exchange(other.class_counts_, {});
+  }
+  return *this;
+}
+
+std::span<const uint8_t> IdxDataset::images() const noexcept {
+  if (!image_file_.data) return {};
+  return {image_file_.data + IMAGE_HEADER, size_*image_size()};
+}
+
+std::span<const uint8_t> IdxDataset::image(const size_t i) const noexcept {
+  return images().subspan(i*image_size(), image_size());
+}
+
+std::span<const uint8_t> IdxDataset::labels() const noexcept {
+  if (!label_file_.data) return {};
+  return {label_file_.data + LABEL_HEADER, size_};
+}
+
+IdxDataset::Split IdxDataset::split(const uint32_t seed,
+                                    const double training,
+                                    const double validation) const {
+  if (training < 0 || validation < 0 || training + validation > 1)
+    throw std::invalid_argument("Split fractions must add up to at most 1.");
+  const auto train_size = static_cast<size_t>(size_*training);
+  const auto validation_size = static_cast<size_t>(size_*validation);
+  std::vector<size_t> indices(size_);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::mt19937 g(seed);
+  std::ranges::shuffle(indices, g);
+
+  const auto a = indices.begin() + static_cast<long>(train_size);
+  const auto b = a + static_cast<long>(validation_size);
+  return {{indices.begin(), a}, {a, b}, {b, indices.end()}};
+}
@@ -1,35 +1,73 @@
 #include "../include/layer.hpp"
 
+template <typename T, typename... Args>
+T generate_weight(const UnaryOp &activation, Args... args) {
+  static std::random_device rd;
+  static std::mt19937 gen(rd());
+
+  if (activation==UnaryOp::relu) {
+    /* Calculate He initialization using the first argument */
+    auto nin = std::get<0>(std::make_tuple(args...));
+    return std::normal_distribution<T>(
+        0, std::sqrt(2.0/static_cast<double>(nin)))(gen);
+  }
+  if (activation==UnaryOp::softmax) {
+    /* Calculate Xavier initialization using both arguments */
+    auto [nin, nout] = std::make_tuple(args...);
+    return std::normal_distribution<T>(
+        0, std::sqrt(2.0/static_cast<double>(nin + nout)))(gen);
+  }
+  std::cout << "Need to implement init method for this activation function\n";
+  return T{};
+}
+
 template <typename T>
 Layer<T>::Layer(const size_t nin,
                 const size_t nout,
                 const UnaryOp &activation)
-    : activation_(activation),
+    : nin_(nin),
+      nout_(nout),
+      storage_(2*nout*(nin + 1), static_cast<T>(0)),
+      activation_(activation),
       num_params_(nout*(nin + 1)) {
-  neurons_.reserve(nout);
-  for (size_t i = 0; i < nout; i++) {
-    neurons_.emplace_back(Neuron<T>(nin, nout, activation));
-  }
+  point_to(storage_.data(), storage_.data() + num_params_);
+  std::generate_n(weights(), nout*nin, [&] {
+    return generate_weight<T>(activation, nin, nout);
+  });
+  std::fill_n(bias(), nout, static_cast<T>(1e-5));
 }
 
 template <typename T>
 Layer<T>::Layer(const Layer &other)
-    : neurons_(other.neurons_),
+    : nin_(other.nin_),
+      nout_(other.nout_),
+      storage_(2*other.num_params_),
       activation_(other.activation_),
-      num_params_(other.num_params_) {}
+      num_params_(other.num_params_) {
+  point_to(storage_.data(), storage_.data() + num_params_);
+  std::copy_n(other.params_, num_params_, params_);
+  std::copy_n(other.grads_, num_params_, grads_);
+}
 
+/* An attached layer's view moves with it */
 template <typename T>
 Layer<T>::Layer(Layer &&other) noexcept
-    : neurons_(std::move(other.neurons_)),
-      activation_(std::move(other.activation_)),
-      num_params_(other.num_params_) {}
+    : nin_(other.nin_),
+      nout_(other.nout_),
+      storage_(std::move(other.storage_)),
+      activation_(other.activation_),
+      num_params_(other.num_params_) {
+  if (storage_.empty())
+    point_to(other.params_, other.grads_);
+  else
+    point_to(storage_.data(), storage_.data() + num_params_);
+}
 
 template <typename T>
 Layer<T> &Layer<T>::operator=(const Layer &other) {
   if (this!=&other) {
-    neurons_ = other.neurons_;
-    activation_ = other.activation_;
-    num_params_ = other.num_params_;
+    Layer copy(other);
+    *this = std::move(copy);
   }
   return *this;
 }
@@ -37,35 +75,69 @@ Layer<T> &Layer<T>::operator=(const Layer &other) {
 template <typename T>
 Layer<T> &Layer<T>::operator=(Layer &&other) noexcept {
   if (this!=&other) {
-    neurons_ = std::move(other.neurons_);
+    nin_ = other.nin_;
+    nout_ = other.nout_;
+    storage_ = std::move(other.storage_);
     activation_ = other.activation_;
     num_params_ = other.num_params_;
+    if (storage_.empty())
+      point_to(other.params_, other.grads_);
+    else
+      point_to(storage_.data(), storage_.data() + num_params_);
   }
   return *this;
 }
 
+template <typename T>
+void Layer<T>::point_to(T *params, T *grads) noexcept {
+  params_ = params;
+  grads_ = grads;
+  param_ = {{params, num_params_}, {grads, num_params_}};
+}
+
+template <typename T>
+void Layer<T>::attach(T *params, T *grads) {
+  std::copy_n(params_, num_params_, params);
+  std::copy_n(grads_, num_params_, grads);
+  point_to(params, grads);
+  storage_ = aligned_vector<T>();
+}
+
 template <typename T>
 ParamVector<T> Layer<T>::get_parameters() const {
-  ParamVector<T> params;
-  params.reserve(num_params_);
-  for (const auto &n : neurons_) {
-    auto temp = n.get_parameters();
-    params.insert(params.end(), temp.begin(), temp.end());
+  return {&param_, 1};
+}
+
+template <typename T>
+Neuron<T> Layer<T>::neuron(const size_t i) const noexcept {
+  return Neuron<T>(weights() + i*nin_, weight_grad() + i*nin_,
+                   bias() + i, bias_grad() + i, nin_, activation_);
+}
+
+template <typename T>
+Output<T> Layer<T>::logits(const std::vector<Value<T>> &inputs) const {
+  Output<T> output;
+  output.reserve(nout_);
+  for (size_t i = 0; i < nout_; i++) {
+    const ops::ParamRow<T> row{weights() + i*nin_, weight_grad() + i*nin_,
+                               bias() + i, bias_grad() + i, nin_};
+    output.emplace_back(ops::dot(row, inputs));
   }
-  return params;
+  return output;
 }
 
 template <typename T>
 Output<T> Layer<T>::operator()(const std::vector<Value<T>> &inputs) const {
   Output<T> output;
-  for (const auto &n : neurons_) {
-    output.emplace_back(n(inputs));
+  output.reserve(nout_);
+  for (size_t i = 0; i < nout_; i++) {
+    output.emplace_back(neuron(i)(inputs));
   }
   if (activation_==UnaryOp::softmax) {
     auto max_val = *std::max_element(
         output.begin(), output.end(),
         [&](const Value<T> &a, const Value<T> &b) { return a < b; });
-    auto sum = Value(0.0);
+    auto sum = Value(static_cast<T>(0));
     for (auto &o : output) {
       o = ops::exp(o - max_val);
       sum += o;
@@ -86,15 +158,59 @@ Output<T> Layer<T>::operator()(const std::vector<T> &input) const {
   return operator()(new_input);
 }
 
+/* inputs: batch x nin, one sample per row. Returns batch x nout. */
+template <typename T>
+TensorValue<T> Layer<T>::logits(const TensorValue<T> &inputs) const {
+  const auto w = TensorValue<T>::bind(weights(), weight_grad(), nout_, nin_);
+  const auto b = TensorValue<T>::bind(bias(), bias_grad(), 1, nout_);
+  return ops::add_bias(ops::matmul(inputs, w, true), b);
+}
+
+template <typename T>
+TensorValue<T> Layer<T>::operator()(const TensorValue<T> &inputs) const {
+  const auto z = logits(inputs);
+  if (activation_==UnaryOp::softmax)
+    return ops::softmax(z);
+  return ops::relu(z);
+}
+
 template <typename T>
 [[nodiscard]] std::vector<T> Layer<T>::predict(const std::vector<T> &input) const {
-  std::vector<T> out;
-  out.reserve(neurons_.size());
-  for (const auto &n : neurons_) {
-    out.emplace_back(n.predict(input));
+  if (input.size()!=nin_) {
+    throw std::invalid_argument(
+        "Vector sizes must be of equal length for dot product calculation.");
   }
+  std::vector<T> out(nout_);
+  predict(input.data(), 1, out.data());
   return out;
 }
 
+/* output = act(X·Wᵀ + b) with X batch x nin and output batch x nout */
+template <typename T>
+void Layer<T>::predict(const T *input, const size_t batch, T *output) const {
+  for (size_t i = 0; i < batch; i++)
+    std::copy_n(bias(), nout_, output + i*nout_);
+  gemm(false, true, batch, nout_, nin_, input, nin_,
+       weights(), nin_, output, nout_, true);
+  for (size_t i = 0; i < batch; i++) {
+    T *row = output + i*nout_;
+    if (activation_==UnaryOp::softmax) {
+      const T max_val = *std::max_element(row, row + nout_);
+      T sum = 0;
+      for (size_t j = 0; j < nout_; j++) {
+        row[j] = std::exp(row[j] - max_val);
+        sum += row[j];
+      }
+      for (size_t j = 0; j < nout_; j++) row[j] /= sum;
+    } else {
+      for (size_t j = 0; j < nout_; j++)
+        row[j] = std::max(row[j], static_cast<T>(0));
+    }
+  }
+}
+
 template
 class Layer<double>;
+
+template
+class Layer<float>;
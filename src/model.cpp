@@ -1,34 +1,67 @@
+#include <cstring>
 #include "../include/model.hpp"
 
 template <typename T>
-MLP<T>::MLP(const MLP &other) : layers_(other.layers_) {}
+MLP<T>::MLP(const MLP &other) : layers_(other.layers_) {
+  register_parameters();
+}
 
 template <typename T>
-MLP<T>::MLP(const std::vector<Layer<T>> &layers) : layers_(layers) {}
+MLP<T>::MLP(const std::vector<Layer<T>> &layers) : layers_(layers) {
+  register_parameters();
+}
 
 template <typename T>
-MLP<T>::MLP(std::vector<Layer<T>> &&layers) noexcept {
-  layers_ = std::move(layers);
+MLP<T>::MLP(std::vector<Layer<T>> &&layers) : layers_(std::move(layers)) {
+  register_parameters();
+}
+
+template <typename T>
+void MLP<T>::register_parameters() {
+  size_t size = 0;
+  for (const auto &l : layers_) size += l.num_params();
+  params_.assign(size, static_cast<T>(0));
+  grads_.assign(size, static_cast<T>(0));
+  size_t offset = 0;
+  for (auto &l : layers_) {
+    l.attach(params_.data() + offset, grads_.data() + offset);
+    offset += l.num_params();
+  }
+  param_ = {{params_.data(), size}, {grads_.data(), size}};
 }
 
 template <typename T>
 [[nodiscard]] ParamVector<T> MLP<T>::get_parameters() const {
-  ParamVector<T> params;
-  size_t total_params = 0;
-  for (const auto &l : layers_) total_params += l.num_params();
-  params.reserve(total_params);
-  for (const auto &l : layers_) {
-    auto lparams = l.get_parameters();
-    params.insert(params.end(), lparams.begin(), lparams.end());
+  return {&param_, 1};
+}
+
+template <typename T>
+void MLP<T>::share_parameters(const MLP &source) {
+  if (source.layers_.size()!=layers_.size()) {
+    throw std::invalid_argument("Models must have the same layers to share"
+                                " parameters.");
   }
-  return params;
+  for (size_t i = 0; i < layers_.size(); i++) {
+    if (source.layers_[i].nin()!=layers_[i].nin() ||
+        source.layers_[i].nout()!=layers_[i].nout()) {
+      throw std::invalid_argument("Models must have the same layers to share"
+                                  " parameters.");
+    }
+  }
+  /* source may itself be sharing another model's arena */
+  T *params = source.param_.data.data();
+  size_t offset = 0;
+  for (auto &l : layers_) {
+    l.share_parameters(params + offset);
+    offset += l.num_params();
+  }
+  params_ = aligned_vector<T>();
+  param_ = {{params, grads_.size()}, {grads_.data(), grads_.size()}};
 }
 
 template <typename T>
 void MLP<T>::zero_grad() const {
-  for (const auto &p : get_parameters()) {
-    p->zero_grad();
-  }
+  std::memset(grads_.data(), 0, grads_.size()*sizeof(T));
 }
 
 template <typename T>
@@ -49,6 +82,32 @@ Output<T> MLP<T>::operator()(const std::vector<T> &input) const {
   return operator()(new_input);
 }
 
+template <typename T>
+TensorValue<T> MLP<T>::operator()(const TensorValue<T> &inputs) const {
+  auto output = inputs;
+  for (const auto &l : layers_) {
+    output = l(output);
+  }
+  return output;
+}
+
+template <typename T>
+Output<T> MLP<T>::logits(const std::vector<T> &input) const {
+  std::vector<Value<T>> output;
+  output.reserve(input.size());
+  for (const auto &val : input)
+    output.emplace_back(Value(static_cast<T>(val), false));
+  for (size_t i = 0; i + 1 < layers_.size(); i++) output = layers_[i](output);
+  return layers_.back().logits(output);
+}
+
+template <typename T>
+TensorValue<T> MLP<T>::logits(const TensorValue<T> &inputs) const {
+  auto output = inputs;
+  for (size_t i = 0; i + 1 < layers_.size(); i++) output = layers_[i](output);
+  return layers_.back().logits(output);
+}
+
 template <typename T>
 uint8_t MLP<T>::predict(const std::vector<T> &input) const {
   std::vector<T> out = input;
@@ -64,5 +123,137 @@ uint8_t MLP<T>::predict(const std::vector<T> &input) const {
   }
 }
 
+/* Shards the inputs over the pool. Each chunk runs micro-batches of up to
+ * PREDICT_BATCH samples through the layers as GEMMs, ping-ponging between
+ * per-thread scratch buffers, and tallies its own hits. */
+template <typename T>
+template <class Load>
+BatchPredictions MLP<T>::predict_rows(const size_t n,
+                                      const std::span<const uint8_t> targets,
+                                      const bool with_confusion,
+                                      ThreadPool &pool,
+                                      Load load) const {
+  constexpr size_t PREDICT_BATCH = 64;
+  if (!targets.empty() && targets.size()!=n) {
+    throw std::invalid_argument(
+        "predict_batch expects one target per input.");
+  }
+  const size_t nin = layers_.front().nin();
+  const size_t classes = layers_.back().nout();
+  size_t widest = 0;
+  for (const auto &layer : layers_) widest = std::max(widest, layer.nout());
+  const bool tally = !targets.empty();
+
+  BatchPredictions result;
+  result.labels.resize(n);
+  result.num_classes = classes;
+  if (tally && with_confusion) result.confusion.assign(classes*classes, 0);
+  std::atomic<size_t> correct{0};
+  std::mutex confusion_mutex;
+
+  pool.parallel_for(0, n, [&](const size_t lo, const size_t hi) {
+    thread_local aligned_vector<T> batch;
+    thread_local aligned_vector<T> ping;
+    thread_local aligned_vector<T> pong;
+    thread_local std::vector<size_t> confusion;
+    batch.resize(PREDICT_BATCH*nin);
+    ping.resize(PREDICT_BATCH*widest);
+    pong.resize(PREDICT_BATCH*widest);
+    confusion.assign(result.confusion.size(), 0);
+    size_t hits = 0;
+
+    for (size_t start = lo; start < hi; start += PREDICT_BATCH) {
+      const size_t rows = std::min(PREDICT_BATCH, hi - start);
+      for (size_t r = 0; r < rows; r++)
+        load(start + r, batch.data() + r*nin);
+      const T *x = batch.data();
+      T *out = ping.data();
+      T *spare = pong.data();
+      for (const auto &layer : layers_) {
+        layer.predict(x, rows, out);
+        x = out;
+        std::swap(out, spare);
+      }
+      for (size_t r = 0; r < rows; r++) {
+        const T *row = x + r*classes;
+        const auto label = static_cast<uint8_t>(
+            std::distance(row, std::max_element(row, row + classes)));
+        result.labels[start + r] = label;
+        if (!tally) continue;
+        const auto target = targets[start + r];
+        hits += label==target;
+        if (!confusion.empty() && target < classes)
+          ++confusion[target*classes + label];
+      }
+    }
+
+    correct.fetch_add(hits, std::memory_order_relaxed);
+    if (!confusion.empty()) {
+      std::lock_guard lock(confusion_mutex);
+      for (size_t i = 0; i < confusion.size(); i++)
+        result.confusion[i] += confusion[i];
+    }
+  }, PREDICT_BATCH);
+
+  if (tally && n > 0)
+    result.accuracy = static_cast<double>(correct.load())/
+        static_cast<double>(n);
+  return result;
+}
+
+template <typename T>
+BatchPredictions MLP<T>::predict_batch(const std::vector<std::vector<T>> &inputs,
+                                       const std::vector<uint8_t> &targets,
+                                       const bool with_confusion,
+                                       ThreadPool &pool) const {
+  const size_t nin = layers_.front().nin();
+  return predict_rows(inputs.size(), targets, with_confusion, pool,
+                      [&](const size_t i, T *row) {
+    const auto &input = inputs[i];
+    if (input.size()!=nin) {
+      throw std::invalid_argument("Vector sizes must be of equal length"
+                                  " for dot product calculation.");
+    }
+    std::copy(input.begin(), input.end(), row);
+  });
+}
+
+template <typename T>
+BatchPredictions MLP<T>::predict_batch(const std::span<const uint8_t> pixels,
+                                       const std::span<const uint8_t> targets,
+                                       const PixelScale<T> &scale,
+                                       const bool with_confusion,
+                                       ThreadPool &pool) const {
+  const size_t nin = layers_.front().nin();
+  if (pixels.size()%nin!=0) {
+    throw std::invalid_argument("predict_batch expects whole images of "
+                                + std::to_string(nin) + " pixels.");
+  }
+  return predict_rows(pixels.size()/nin, targets, with_confusion, pool,
+                      [&](const size_t i, T *row) {
+    scale.convert(pixels.data() + i*nin, nin, row);
+  });
+}
+
+template <typename T>
+BatchPredictions MLP<T>::predict_batch(const BatchView &batch,
+                                       const PixelScale<T> &scale,
+                                       const bool with_confusion,
+                                       ThreadPool &pool) const {
+  const size_t nin = layers_.front().nin();
+  if (batch.image_size()!=nin) {
+    throw std::invalid_argument("predict_batch expects images of "
+                                + std::to_string(nin) + " pixels.");
+  }
+  std::vector<uint8_t> labels;
+  return predict_rows(batch.size(), batch.labels(labels), with_confusion,
+                      pool, [&](const size_t i, T *row) {
+    scale.convert(batch.image(i), nin, row);
+  });
+}
+
 template
 class MLP<double>;
+
+template
+class MLP<float>;
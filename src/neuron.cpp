@@ -1,92 +1,21 @@
 #include "../include/neuron.hpp"
 
-template <typename T, typename... Args>
-T generate_weight(const UnaryOp &activation, Args... args) {
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
-
-  if (activation==UnaryOp::relu) {
-    /* Calculate He initialization using the first argument */
-    auto nin = std::get<0>(std::make_tuple(args...));
-    return std::normal_distribution<T>(
-        0, std::sqrt(2.0/static_cast<double>(nin)))(gen);
-  }
-  if (activation==UnaryOp::softmax) {
-    /* Calculate Xavier initialization using both arguments */
-    auto [nin, nout] = std::make_tuple(args...);
-    return std::normal_distribution<T>(
-        0, std::sqrt(2.0/static_cast<double>(nin + nout)))(gen);
-  }
-  std::cout << "Need to implement init method for this activation function\n";
-  return T{};
-}
-
-template <class T>
-Neuron<T>::Neuron(const Neuron &other) {
-  weights_ = other.weights_;
-  bias_ = other.bias_;
-  activation_ = other.activation_;
-}
-
-template <typename T>
-Neuron<T>::Neuron(const size_t nin, const size_t nout,
-                  const UnaryOp &activation)
-    : activation_(activation) {
-  for (size_t i = 0; i < nin; i++) {
-    weights_.emplace_back(
-        Value<T>(generate_weight<T>(activation, nin, nout)));
-    bias_ = Value<T>(1e-5);
-  }
-}
-
-template <typename T>
-Neuron<T>::Neuron(Neuron &&other) noexcept {
-  weights_ = std::move(other.weights_);
-  bias_ = std::move(other.bias_);
-  activation_ = other.activation_;
-}
-
 template <typename T>
-Neuron<T> &Neuron<T>::operator=(const Neuron &other) {
-  if (this!=&other) {
-    weights_ = other.weights_;
-    bias_ = other.bias_;
-    activation_ = other.activation_;
-  }
-  return *this;
-}
-
-template <typename T>
-Neuron<T> &Neuron<T>::operator=(Neuron &&other) noexcept {
-  if (this!=&other) {
-    weights_ = std::move(other.weights_);
-    bias_ = std::move(other.bias_);
-    activation_ = other.activation_;
-  }
-  return *this;
-}
+Neuron<T>::Neuron(T *weights, T *weight_grad, T *bias, T *bias_grad,
+                  const size_t nin, const UnaryOp &activation)
+    : row_{weights, weight_grad, bias, bias_grad, nin},
+      params_{{{{weights, nin}, {weight_grad, nin}},
+               {{bias, 1}, {bias_grad, 1}}}},
+      activation_(activation) {}
 
 template <typename T>
 ParamVector<T> Neuron<T>::get_parameters() const {
-  ParamVector<T> rvec;
-  rvec.reserve(weights_.size() + 1);
-  for (const auto &w : weights_) {
-    rvec.emplace_back(std::make_shared < Value < T >> (w));
-  }
-  rvec.emplace_back(std::make_shared < Value < T >> (bias_));
-  return rvec;
+  return params_;
 }
 
 template <typename T>
 Value<T> Neuron<T>::operator()(const std::vector<Value<T>> &input) const {
-  if (input.size()!=weights_.size()) {
-    throw std::invalid_argument(
-        "Vector sizes must be of equal length for dot product calculation.");
-  }
-  Value<T> rval = bias_;
-  for (size_t i = 0; i < input.size(); i++) {
-    if (input[i].get_data()!=0) rval += input[i]*weights_[i];
-  }
+  const auto rval = ops::dot(row_, input);
   if (activation_==UnaryOp::relu)
     return relu(rval);
   return rval;
@@ -94,25 +23,34 @@ Value<T> Neuron<T>::operator()(const std::vector<Value<T>> &input) const {
 
 template <typename T>
 Value<T> Neuron<T>::operator()(const std::vector<T> &input) const {
-  auto rval = bias_;
-  for (size_t i = 0; i < input.size(); i++) {
-    rval += input[i]*weights_[i];
+  std::vector<Value<T>> new_input;
+  new_input.reserve(input.size());
+  for (const auto t : input) {
+    new_input.emplace_back(Value(t, false));
   }
-  return rval;
+  return ops::dot(row_, new_input);
 }
 
 template <typename T>
 T Neuron<T>::predict(const std::vector<T> &input) const {
-  T output = bias_.get_data();
-  if (input.size()!=weights_.size()) {
+  if (input.size()!=row_.size) {
     throw std::invalid_argument(
         "Vector sizes must be of equal length for dot product calculation.");
   }
-  for (size_t i{0}; i < input.size(); i++) {
-    output += weights_[i].get_data()*input[i];
+  return predict(input.data());
+}
+
+template <typename T>
+T Neuron<T>::predict(const T *input) const noexcept {
+  T output = *row_.bias;
+  for (size_t i{0}; i < row_.size; i++) {
+    output += row_.weights[i]*input[i];
   }
   return std::max(output, static_cast<T>(0));
 }
 
 template
 class Neuron<double>;
+
+template
+class Neuron<float>;
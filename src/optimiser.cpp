@@ -1,10 +1,220 @@
 #include "../include/optimiser.hpp"
 #include "../include/model.hpp"
+#include <atomic>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MICROGRAD_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/* The Adam kernels must not contract a*b + c into FMAs, or their results
+ * would depend on the instruction set. GCC contracts by default, also
+ * across intrinsics; clang only within an expression, which the pragma
+ * turns off. */
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#define MICROGRAD_NO_CONTRACT
+#elif defined(__GNUC__)
+#define MICROGRAD_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define MICROGRAD_NO_CONTRACT
+#endif
+
+namespace {
+/* Per-step constants of the Adam update, computed once by step_impl */
+template <typename T>
+struct AdamStep {
+  double beta_1;
+  double one_minus_beta_1;
+  double beta_2;
+  double one_minus_beta_2;
+  double alpha_t;
+  double eps_p;
+  T clip;
+  uint64_t t;
+};
+
+/* Rounding noise for the moments of parameter idx at step t, taken from a
+ * counter-based hash (splitmix64) so it doesn't depend on how the step is
+ * sharded. The low and high halves serve m and v. */
+inline uint32_t dither(const uint64_t t, const uint64_t idx) noexcept {
+  uint64_t z = (t << 40 ^ idx) + 0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+  return static_cast<uint32_t>(z ^ (z >> 31));
+}
+
+template <typename M>
+M narrow(const double x, [[maybe_unused]] const uint16_t random) noexcept {
+  if constexpr (std::is_same_v<M, bfloat16>)
+    return bfloat16::stochastic(static_cast<float>(x), random);
+  else
+    return static_cast<M>(x);
+}
+
+template <typename M>
+double widen(const M x) noexcept {
+  if constexpr (std::is_same_v<M, bfloat16>)
+    return static_cast<double>(static_cast<float>(x));
+  else
+    return static_cast<double>(x);
+}
+
+/* Clip, moment update and weight write fused into one pass over [0, n).
+ * first is the index of element 0 within the whole parameter arena. With
+ * master weights the step is applied to them and w receives the rounded
+ * result. */
+template <typename T, typename M>
+MICROGRAD_NO_CONTRACT
+void adam_update_scalar(const AdamStep<T> &s, T *w, const T *g,
+                        M *m, M *v, double *master,
+                        const size_t n, const size_t first) {
+  for (size_t i = 0; i < n; i++) {
+    const double grad = std::clamp(g[i], -s.clip, s.clip);
+    const double mi = s.beta_1*widen(m[i]) + s.one_minus_beta_1*grad;
+    const double vi = s.beta_2*widen(v[i]) + s.one_minus_beta_2*(grad*grad);
+    if constexpr (std::is_same_v<M, bfloat16>) {
+      const uint32_t random = dither(s.t, first + i);
+      m[i] = narrow<M>(mi, static_cast<uint16_t>(random));
+      v[i] = narrow<M>(vi, static_cast<uint16_t>(random >> 16));
+    } else {
+      m[i] = narrow<M>(mi, 0);
+      v[i] = narrow<M>(vi, 0);
+    }
+    const double step = s.alpha_t*mi/(std::sqrt(vi) + s.eps_p);
+    if (master) {
+      master[i] -= step;
+      w[i] = static_cast<T>(master[i]);
+    } else {
+      w[i] -= static_cast<T>(step);
+    }
+  }
+}
+
+#ifdef MICROGRAD_X86_KERNELS
+/* The vector kernels perform the scalar loop's operations in the same order
+ * without FMAs, so every lane matches it bit for bit. One iteration covers a
+ * cache line of each array. The AVX-512 tail is a masked iteration: inactive
+ * lanes load zero and are never stored. Its max/min/sqrt are the zero-masking
+ * forms too, as the plain intrinsics start from an undefined vector that
+ * -Wmaybe-uninitialized flags. */
+MICROGRAD_NO_CONTRACT __attribute__((target("avx512f")))
+size_t adam_update_avx512(const AdamStep<double> &s, double *w,
+                          const double *g, double *m, double *v,
+                          const size_t n) {
+  const __m512d lo = _mm512_set1_pd(-s.clip);
+  const __m512d hi = _mm512_set1_pd(s.clip);
+  const __m512d b1 = _mm512_set1_pd(s.beta_1);
+  const __m512d c1 = _mm512_set1_pd(s.one_minus_beta_1);
+  const __m512d b2 = _mm512_set1_pd(s.beta_2);
+  const __m512d c2 = _mm512_set1_pd(s.one_minus_beta_2);
+  const __m512d alpha = _mm512_set1_pd(s.alpha_t);
+  const __m512d eps = _mm512_set1_pd(s.eps_p);
+  for (size_t i = 0; i < n; i += 8) {
+    const __mmask8 k = n - i >= 8 ? 0xFF :
+        static_cast<__mmask8>((1u << (n - i)) - 1);
+    const __m512d grad = _mm512_maskz_min_pd(
+        k, _mm512_maskz_max_pd(k, _mm512_maskz_loadu_pd(k, g + i), lo), hi);
+    const __m512d mi = _mm512_add_pd(
+        _mm512_mul_pd(b1, _mm512_maskz_loadu_pd(k, m + i)),
+        _mm512_mul_pd(c1, grad));
+    const __m512d vi = _mm512_add_pd(
+        _mm512_mul_pd(b2, _mm512_maskz_loadu_pd(k, v + i)),
+        _mm512_mul_pd(c2, _mm512_mul_pd(grad, grad)));
+    const __m512d step = _mm512_div_pd(
+        _mm512_mul_pd(alpha, mi),
+        _mm512_add_pd(_mm512_maskz_sqrt_pd(k, vi), eps));
+    _mm512_mask_storeu_pd(m + i, k, mi);
+    _mm512_mask_storeu_pd(v + i, k, vi);
+    _mm512_mask_storeu_pd(
+        w + i, k, _mm512_sub_pd(_mm512_maskz_loadu_pd(k, w + i), step));
+  }
+  return n;
+}
+
+MICROGRAD_NO_CONTRACT __attribute__((target("avx2")))
+size_t adam_update_avx2(const AdamStep<double> &s, double *w,
+                        const double *g, double *m, double *v,
+                        const size_t n) {
+  const __m256d lo = _mm256_set1_pd(-s.clip);
+  const __m256d hi = _mm256_set1_pd(s.clip);
+  const __m256d b1 = _mm256_set1_pd(s.beta_1);
+  const __m256d c1 = _mm256_set1_pd(s.one_minus_beta_1);
+  const __m256d b2 = _mm256_set1_pd(s.beta_2);
+  const __m256d c2 = _mm256_set1_pd(s.one_minus_beta_2);
+  const __m256d alpha = _mm256_set1_pd(s.alpha_t);
+  const __m256d eps = _mm256_set1_pd(s.eps_p);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256d grad = _mm256_min_pd(_mm256_max_pd(_mm256_loadu_pd(g + i),
+                                                     lo), hi);
+    const __m256d mi = _mm256_add_pd(_mm256_mul_pd(b1, _mm256_loadu_pd(m + i)),
+                                     _mm256_mul_pd(c1, grad));
+    const __m256d vi = _mm256_add_pd(
+        _mm256_mul_pd(b2, _mm256_loadu_pd(v + i)),
+        _mm256_mul_pd(c2, _mm256_mul_pd(grad, grad)));
+    const __m256d step = _mm256_div_pd(
+        _mm256_mul_pd(alpha, mi), _mm256_add_pd(_mm256_sqrt_pd(vi), eps));
+    _mm256_storeu_pd(m + i, mi);
+    _mm256_storeu_pd(v + i, vi);
+    _mm256_storeu_pd(w + i, _mm256_sub_pd(_mm256_loadu_pd(w + i), step));
+  }
+  return i;
+}
+#endif
+
+template <typename T, typename M>
+void adam_update(const AdamStep<T> &s, T *w, const T *g, M *m, M *v,
+                 double *master, const size_t n, const size_t first) {
+  adam_update_scalar(s, w, g, m, v, master, n, first);
+}
+
+void adam_update(const AdamStep<double> &s, double *w, const double *g,
+                 double *m, double *v, double *master,
+                 const size_t n, const size_t first) {
+  size_t done = 0;
+#ifdef MICROGRAD_X86_KERNELS
+  const auto isa = adam_isa();
+  if (isa==AdamIsa::avx512)
+    done = adam_update_avx512(s, w, g, m, v, n);
+  else if (isa==AdamIsa::avx2)
+    done = adam_update_avx2(s, w, g, m, v, n);
+#endif
+  adam_update_scalar(s, w + done, g + done, m + done, v + done, master,
+                     n - done, first + done);
+}
+} // namespace
+
+static AdamIsa best_supported_adam_isa() noexcept {
+#ifdef MICROGRAD_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return AdamIsa::avx512;
+  if (__builtin_cpu_supports("avx2")) return AdamIsa::avx2;
+#endif
+  return AdamIsa::scalar;
+}
+
+/* Atomic, as set_adam_isa may run while pool threads are in step() */
+static std::atomic<AdamIsa> &selected_adam_isa() noexcept {
+  static std::atomic<AdamIsa> isa{best_supported_adam_isa()};
+  return isa;
+}
+
+AdamIsa adam_isa() noexcept {
+  return selected_adam_isa().load(std::memory_order_relaxed);
+}
+
+AdamIsa set_adam_isa(const AdamIsa isa) noexcept {
+  const auto best = best_supported_adam_isa();
+  const auto chosen = static_cast<uint8_t>(isa) <= static_cast<uint8_t>(best)
+                      ? isa : best;
+  selected_adam_isa().store(chosen, std::memory_order_relaxed);
+  return chosen;
+}
 
 template <class Derived, typename T>
 void Optimiser<Derived, T>::zero_grad() {
-  for (const auto &p : mptr_->get_parameters())
-    p->zero_grad();
+  mptr_->zero_grad();
 }
 
 template <typename T>
@@ -24,29 +234,41 @@ void Adam<T>::step_impl() {
     end while \n
     **/
 
-  this->t_++;
-  const auto &params = this->mptr_->get_parameters();
-  std::for_each(params.begin(), params.end(), [&](auto &p) {
-    p->get_grad() = std::clamp(p->get_grad(), -this->clip_val_,
-                               this->clip_val_);
-  });
-
-  for (size_t i = 0; i < m_.size(); i++) {
-    m_[i] = beta_1_*m_[i] + (1 - beta_1_)*params[i]->get_grad();
-    v_[i] = beta_2_*v_[i] + (1 - beta_2_)*
-        std::pow(params[i]->get_grad(), 2);
+  /* The master weights are read from the model at the first step rather
+   * than at construction, so weights set in between (e.g. broadcast by
+   * DistributedDataParallel) aren't overwritten by the ones it started with */
+  if (this->t_==0 && !master_.empty()) {
+    auto out = master_.begin();
+    for (const auto &p : this->mptr_->get_parameters())
+      out = std::copy(p.data.begin(), p.data.end(), out);
   }
 
-  const auto alpha_t = this->step_size_*
-      std::sqrt(1 - std::pow(beta_2_, this->t_))/
-      (1 - std::pow(beta_1_, this->t_));
-  const double eps_p = eps_*std::sqrt(1 - std::pow(beta_2_, this->t_));
+  this->t_++;
+  const double bias_1 = 1 - std::pow(beta_1_, static_cast<double>(this->t_));
+  const double bias_2 = 1 - std::pow(beta_2_, static_cast<double>(this->t_));
+  const AdamStep<T> s{beta_1_, 1 - beta_1_, beta_2_, 1 - beta_2_,
+                      this->step_size_*std::sqrt(bias_2)/bias_1,
+                      eps_*std::sqrt(bias_2),
+                      static_cast<T>(this->clip_val_),
+                      static_cast<uint64_t>(this->t_)};
 
-  size_t idx = 0;
-  for (auto &param : params) {
-    param->get_data() -= alpha_t*m_[idx]/(std::sqrt(v_[idx]) + eps_p);
-    ++idx;
-  }
+  std::visit([&](auto &moments) {
+    using M = typename std::decay_t<decltype(moments.m)>::value_type;
+    size_t offset = 0;
+    for (const auto &p : this->mptr_->get_parameters()) {
+      const size_t n = p.data.size();
+      T *w = p.data.data();
+      const T *g = p.grad.data();
+      M *m = moments.m.data() + offset;
+      M *v = moments.v.data() + offset;
+      double *master = master_.empty() ? nullptr : master_.data() + offset;
+      this->for_each_shard(n, [&](const size_t lo, const size_t hi) {
+        adam_update(s, w + lo, g + lo, m + lo, v + lo,
+                    master ? master + lo : nullptr, hi - lo, offset + lo);
+      }, CACHE_LINE/std::min(sizeof(T), sizeof(M)));
+      offset += n;
+    }
+  }, moments_);
 }
 
 template
@@ -54,3 +276,9 @@ class Optimiser<Adam<double>, double>;
 
 template
 class Adam<double>;
+
+template
+class Optimiser<Adam<float>, float>;
+
+template
+class Adam<float>;
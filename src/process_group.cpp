@@ -0,0 +1,289 @@
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "../include/process_group.hpp"
+
+namespace {
+constexpr auto CONNECT_TIMEOUT = std::chrono::seconds(60);
+
+[[noreturn]] void fail(const std::string &what) {
+  throw std::runtime_error("ProcessGroup: " + what + ": " +
+      std::strerror(errno));
+}
+
+sockaddr_un socket_address(const std::string &socket_dir, const size_t rank) {
+  const auto path = socket_dir + "/micrograd-rank" + std::to_string(rank) +
+      ".sock";
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path))
+    throw std::invalid_argument("ProcessGroup: socket path too long: " + path);
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return addr;
+}
+
+void send_all(const int fd, const void *data, size_t bytes) {
+  const auto *p = static_cast<const char *>(data);
+  while (bytes > 0) {
+    const auto sent = ::send(fd, p, bytes, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno==EINTR) continue;
+      fail("send");
+    }
+    p += sent;
+    bytes -= static_cast<size_t>(sent);
+  }
+}
+
+void recv_all(const int fd, void *data, size_t bytes) {
+  auto *p = static_cast<char *>(data);
+  while (bytes > 0) {
+    const auto got = ::recv(fd, p, bytes, 0);
+    if (got==0) throw std::runtime_error("ProcessGroup: peer disconnected");
+    if (got < 0) {
+      if (errno==EINTR) continue;
+      fail("recv");
+    }
+    p += got;
+    bytes -= static_cast<size_t>(got);
+  }
+}
+
+size_t env_or(const char *name, const size_t fallback) {
+  const char *env = std::getenv(name);
+  return env ? std::stoul(env) : fallback;
+}
+}
+
+ProcessGroup::ProcessGroup(const size_t rank,
+                           const size_t world_size,
+                           const std::string &socket_dir)
+    : rank_(rank), world_size_(world_size) {
+  if (world_size==0 || rank >= world_size) {
+    throw std::invalid_argument("ProcessGroup: rank " + std::to_string(rank) +
+        " out of range for world size " + std::to_string(world_size));
+  }
+  if (world_size > 1) {
+    try {
+      connect_ring(socket_dir);
+    } catch (...) {
+      if (next_ >= 0) ::close(next_);
+      if (prev_ >= 0) ::close(prev_);
+      throw;
+    }
+  }
+  comm_ = std::thread(&ProcessGroup::run, this);
+}
+
+/* Queued collectives are finished before the connections close */
+ProcessGroup::~ProcessGroup() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  work_.notify_all();
+  comm_.join();
+  if (next_ >= 0) ::close(next_);
+  if (prev_ >= 0) ::close(prev_);
+}
+
+ProcessGroup ProcessGroup::from_env() {
+  const char *dir = std::getenv("MICROGRAD_SOCKET_DIR");
+  return {env_or("MICROGRAD_RANK", 0), env_or("MICROGRAD_WORLD_SIZE", 1),
+          dir ? dir : "/tmp"};
+}
+
+/* Listen first, so the connect from rank - 1 queues in the backlog while
+ * this rank connects onwards; then accept and check who it was */
+void ProcessGroup::connect_ring(const std::string &socket_dir) {
+  const auto own = socket_address(socket_dir, rank_);
+  const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) fail("socket");
+  ::unlink(own.sun_path);
+  if (::bind(listener, reinterpret_cast<const sockaddr *>(&own),
+             sizeof(own)) < 0 || ::listen(listener, 1) < 0) {
+    ::close(listener);
+    fail("bind");
+  }
+
+  try {
+    const auto next = socket_address(socket_dir, (rank_ + 1)%world_size_);
+    const auto deadline = std::chrono::steady_clock::now() + CONNECT_TIMEOUT;
+    while (true) {
+      next_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+      if (next_ < 0) fail("socket");
+      if (::connect(next_, reinterpret_cast<const sockaddr *>(&next),
+                    sizeof(next))==0)
+        break;
+      ::close(next_);
+      next_ = -1;
+      if ((errno!=ENOENT && errno!=ECONNREFUSED) ||
+          std::chrono::steady_clock::now() > deadline)
+        fail("connect to rank " + std::to_string((rank_ + 1)%world_size_));
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const auto me = static_cast<uint32_t>(rank_);
+    send_all(next_, &me, sizeof(me));
+
+    prev_ = ::accept(listener, nullptr, nullptr);
+    if (prev_ < 0) fail("accept");
+    uint32_t from = 0;
+    recv_all(prev_, &from, sizeof(from));
+    if (from!=(rank_ + world_size_ - 1)%world_size_) {
+      throw std::runtime_error("ProcessGroup: rank " + std::to_string(rank_) +
+          " was connected to by rank " + std::to_string(from));
+    }
+  } catch (...) {
+    ::close(listener);
+    ::unlink(own.sun_path);
+    throw;
+  }
+  ::close(listener);
+  ::unlink(own.sun_path);
+}
+
+void ProcessGroup::enqueue(std::function<void()> job) {
+  {
+    std::lock_guard lock(mutex_);
+    jobs_.emplace_back(std::move(job));
+    ++pending_;
+  }
+  work_.notify_one();
+}
+
+void ProcessGroup::wait() {
+  std::unique_lock lock(mutex_);
+  done_.wait(lock, [this] { return pending_==0; });
+  if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+/* After an error the remaining jobs are dropped, the ring is out of step */
+void ProcessGroup::run() {
+  std::unique_lock lock(mutex_);
+  while (true) {
+    work_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+    if (jobs_.empty()) return;
+    auto job = std::move(jobs_.front());
+    jobs_.pop_front();
+    const bool failed = error_!=nullptr;
+    lock.unlock();
+    std::exception_ptr error;
+    if (!failed) {
+      try {
+        job();
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    lock.lock();
+    if (error && !error_) error_ = error;
+    if (--pending_==0) done_.notify_all();
+  }
+}
+
+void ProcessGroup::send_recv(const void *send, size_t send_bytes,
+                             void *recv, size_t recv_bytes) const {
+  const auto *out = static_cast<const char *>(send);
+  auto *in = static_cast<char *>(recv);
+  while (send_bytes > 0 || recv_bytes > 0) {
+    /* poll ignores negative fds, i.e. a direction that is already done */
+    pollfd fds[2] = {{send_bytes > 0 ? next_ : -1, POLLOUT, 0},
+                     {recv_bytes > 0 ? prev_ : -1, POLLIN, 0}};
+    if (::poll(fds, 2, -1) < 0) {
+      if (errno==EINTR) continue;
+      fail("poll");
+    }
+    if (send_bytes > 0 && (fds[0].revents & (POLLOUT | POLLERR | POLLHUP))) {
+      const auto sent = ::send(next_, out, send_bytes,
+                               MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (sent < 0 && errno!=EAGAIN && errno!=EINTR) fail("send");
+      if (sent > 0) {
+        out += sent;
+        send_bytes -= static_cast<size_t>(sent);
+      }
+    }
+    if (recv_bytes > 0 && (fds[1].revents & (POLLIN | POLLERR | POLLHUP))) {
+      const auto got = ::recv(prev_, in, recv_bytes, MSG_DONTWAIT);
+      if (got==0) throw std::runtime_error("ProcessGroup: peer disconnected");
+      if (got < 0 && errno!=EAGAIN && errno!=EINTR) fail("recv");
+      if (got > 0) {
+        in += got;
+        recv_bytes -= static_cast<size_t>(got);
+      }
+    }
+  }
+}
+
+/* Chunk c covers [c·n/W, (c+1)·n/W). In reduce-scatter step s a rank sends
+ * its partial sum of chunk rank - s and adds the one it receives into chunk
+ * rank - s - 1, so after W - 1 steps it holds the full sum of chunk
+ * rank + 1. The all-gather then passes the finished chunks on. */
+template <typename T>
+void ProcessGroup::ring_all_reduce(std::span<T> data) const {
+  const size_t w = world_size_;
+  const size_t n = data.size();
+  if (w==1 || n==0) return;
+  const auto begin = [&](const size_t c) { return c%w*n/w; };
+  const auto size = [&](const size_t c) { return (c%w + 1)*n/w - c%w*n/w; };
+  std::vector<T> incoming((n + w - 1)/w);
+
+  for (size_t s = 0; s + 1 < w; s++) {
+    const size_t out = rank_ + w - s;
+    const size_t in = rank_ + w - s - 1;
+    send_recv(data.data() + begin(out), size(out)*sizeof(T),
+              incoming.data(), size(in)*sizeof(T));
+    T *dst = data.data() + begin(in);
+    for (size_t i = 0; i < size(in); i++) dst[i] += incoming[i];
+  }
+  for (size_t s = 0; s + 1 < w; s++) {
+    const size_t out = rank_ + 1 + w - s;
+    const size_t in = rank_ + w - s;
+    send_recv(data.data() + begin(out), size(out)*sizeof(T),
+              data.data() + begin(in), size(in)*sizeof(T));
+  }
+}
+
+/* root sends to root + 1, which passes it on, and so on round the ring */
+template <typename T>
+void ProcessGroup::chain_broadcast(std::span<T> data, const size_t root) const {
+  const size_t w = world_size_;
+  if (w==1) return;
+  const size_t position = (rank_ + w - root)%w;
+  if (position > 0) send_recv(nullptr, 0, data.data(), data.size_bytes());
+  if (position + 1 < w) send_recv(data.data(), data.size_bytes(), nullptr, 0);
+}
+
+template <typename T>
+void ProcessGroup::all_reduce_async(std::span<T> data) {
+  enqueue([this, data] { ring_all_reduce(data); });
+}
+
+template <typename T>
+void ProcessGroup::all_reduce(std::span<T> data) {
+  all_reduce_async(data);
+  wait();
+}
+
+template <typename T>
+void ProcessGroup::broadcast(std::span<T> data, const size_t root) {
+  if (root >= world_size_)
+    throw std::invalid_argument("ProcessGroup: broadcast root out of range");
+  enqueue([this, data, root] { chain_broadcast(data, root); });
+  wait();
+}
+
+template void ProcessGroup::all_reduce<double>(std::span<double>);
+template void ProcessGroup::all_reduce<float>(std::span<float>);
+template void ProcessGroup::all_reduce_async<double>(std::span<double>);
+template void ProcessGroup::all_reduce_async<float>(std::span<float>);
+template void ProcessGroup::broadcast<double>(std::span<double>, size_t);
+template void ProcessGroup::broadcast<float>(std::span<float>, size_t);
@@ -0,0 +1,169 @@
+#include <cstdlib>
+#include <string>
+#include "../include/thread_pool.hpp"
+
+namespace {
+/* Pool and index of the worker running on this thread, if any */
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+using clock_type = std::chrono::steady_clock;
+}
+
+std::ostream &operator<<(std::ostream &os, const WorkerStats &stats) {
+  os << "WorkerStats(tasks_run=" << stats.tasks_run
+     << ", steals=" << stats.steals
+     << ", idle_ms=" << static_cast<double>(stats.idle.count())*1e-6 << ")";
+  return os;
+}
+
+WorkerStats ThreadPool::Counters::load() const noexcept {
+  return {tasks_run.load(std::memory_order_relaxed),
+          steals.load(std::memory_order_relaxed),
+          std::chrono::nanoseconds(idle_ns.load(std::memory_order_relaxed))};
+}
+
+void ThreadPool::Counters::reset() noexcept {
+  tasks_run.store(0, std::memory_order_relaxed);
+  steals.store(0, std::memory_order_relaxed);
+  idle_ns.store(0, std::memory_order_relaxed);
+}
+
+ThreadPool::ThreadPool(const size_t num_workers) {
+  workers_.reserve(num_workers);
+  for (size_t i = 0; i < num_workers; i++)
+    workers_.emplace_back(std::make_unique<Worker>());
+  threads_.reserve(num_workers);
+  for (size_t i = 0; i < num_workers; i++)
+    threads_.emplace_back(&ThreadPool::work, this, i);
+}
+
+/* Queued tasks are drained before the workers exit */
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto &thread : threads_) thread.join();
+}
+
+ThreadPool &ThreadPool::global() {
+  static ThreadPool pool;
+  return pool;
+}
+
+size_t ThreadPool::default_workers() {
+  if (const char *env = std::getenv("MICROGRAD_NUM_THREADS")) {
+    try {
+      const auto threads = std::stoul(env);
+      return threads > 0 ? threads - 1 : 0;
+    } catch (const std::exception &) {
+      std::cerr << "Ignoring invalid MICROGRAD_NUM_THREADS=" << env << '\n';
+    }
+  }
+  const size_t threads = std::thread::hardware_concurrency();
+  return threads > 0 ? threads - 1 : 0;
+}
+
+std::vector<WorkerStats> ThreadPool::stats() const {
+  std::vector<WorkerStats> result;
+  result.reserve(workers_.size());
+  for (const auto &worker : workers_)
+    result.emplace_back(worker->counters.load());
+  return result;
+}
+
+WorkerStats ThreadPool::external_stats() const {
+  return external_.load();
+}
+
+void ThreadPool::reset_stats() noexcept {
+  for (auto &worker : workers_) worker->counters.reset();
+  external_.reset();
+}
+
+/* Workers push onto their own deque, other threads deal round-robin */
+void ThreadPool::push(Task task) {
+  const size_t target = current_pool==this
+                        ? current_worker
+                        : next_victim_.fetch_add(1, std::memory_order_relaxed)
+                            %workers_.size();
+  /* counted first so queued_ never goes below the number of queued tasks */
+  queued_.fetch_add(1, std::memory_order_release);
+  {
+    std::lock_guard lock(workers_[target]->mutex);
+    workers_[target]->tasks.emplace_back(std::move(task));
+  }
+  {
+    /* taken so the notify can't slip in between a worker's check of
+     * queued_ and its wait */
+    std::lock_guard lock(sleep_mutex_);
+  }
+  wake_.notify_one();
+}
+
+bool ThreadPool::pop(const size_t worker, Task &task) {
+  auto &w = *workers_[worker];
+  std::lock_guard lock(w.mutex);
+  if (w.tasks.empty()) return false;
+  task = std::move(w.tasks.back());
+  w.tasks.pop_back();
+  queued_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+/* Scan the other deques starting after the thief, oldest task first */
+bool ThreadPool::steal(const size_t thief, Task &task) {
+  const size_t n = workers_.size();
+  for (size_t i = 1; i <= n; i++) {
+    auto &victim = *workers_[(thief + i)%n];
+    std::lock_guard lock(victim.mutex);
+    if (victim.tasks.empty()) continue;
+    task = std::move(victim.tasks.front());
+    victim.tasks.pop_front();
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+bool ThreadPool::run_one() {
+  if (workers_.empty()) return false;
+  Task task;
+  if (current_pool==this) {
+    auto &counters = workers_[current_worker]->counters;
+    if (!pop(current_worker, task)) {
+      if (!steal(current_worker, task)) return false;
+      counters.steals.fetch_add(1, std::memory_order_relaxed);
+    }
+    task();
+    counters.tasks_run.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  if (!steal(workers_.size() - 1, task)) return false;
+  task();
+  external_.steals.fetch_add(1, std::memory_order_relaxed);
+  external_.tasks_run.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void ThreadPool::work(const size_t id) {
+  current_pool = this;
+  current_worker = id;
+  auto &counters = workers_[id]->counters;
+  while (true) {
+    if (run_one()) continue;
+    const auto start = clock_type::now();
+    std::unique_lock lock(sleep_mutex_);
+    wake_.wait(lock, [this] {
+      return stop_ || queued_.load(std::memory_order_acquire) > 0;
+    });
+    const bool done = stop_ && queued_.load(std::memory_order_acquire)==0;
+    lock.unlock();
+    counters.idle_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_type::now() - start).count(), std::memory_order_relaxed);
+    if (done) return;
+  }
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include "../include/batch_sampler.hpp"
+
+class BatchSamplerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    /* imbalanced: 600 of class 0, 300 of class 1, 100 of class 2 */
+    for (size_t i = 0; i < 1000; i++)
+      labels.emplace_back(i%10 < 6 ? 0 : i%10 < 9 ? 1 : 2);
+    images.resize(labels.size()*4);
+    indices.resize(labels.size());
+    std::iota(indices.begin(), indices.end(), 0);
+  }
+
+  static std::vector<size_t> order(const BatchSampler &sampler) {
+    std::vector<size_t> all;
+    for (size_t b = 0; b < sampler.num_batches(); b++) {
+      const auto batch = sampler.batch(b);
+      for (size_t i = 0; i < batch.size(); i++) all.emplace_back(batch.index(i));
+    }
+    return all;
+  }
+
+  std::vector<uint8_t> images;
+  std::vector<uint8_t> labels;
+  std::vector<size_t> indices;
+};
+
+TEST_F(BatchSamplerTest, ShufflesPerEpoch) {
+  BatchSampler sampler(images.data(), labels, 4, indices, 64, 9);
+  EXPECT_EQ(sampler.num_batches(), 16);
+  EXPECT_EQ(sampler.batch(15).size(), 1000 - 15*64);
+  EXPECT_EQ(sampler.class_counts(), (std::vector<size_t>{600, 300, 100}));
+  const auto first = order(sampler);
+  auto sorted = first;
+  std::ranges::sort(sorted);
+  EXPECT_EQ(sorted, indices);
+
+  sampler.set_epoch(1);
+  const auto second = order(sampler);
+  EXPECT_NE(second, first);
+  // the order only depends on the seed and the epoch
+  sampler.set_epoch(0);
+  EXPECT_EQ(order(sampler), first);
+  BatchSampler other(images.data(), labels, 4, indices, 64, 9);
+  other.set_epoch(1);
+  EXPECT_EQ(order(other), second);
+
+  const auto shard = sampler.batch(2, 1, 4);
+  EXPECT_EQ(shard.size(), 16);
+  EXPECT_EQ(shard.index(0), first[2*64 + 16]);
+  EXPECT_THROW((void) sampler.batch(16), std::out_of_range);
+}
+
+TEST_F(BatchSamplerTest, Stratified) {
+  BatchSampler sampler(images.data(), labels, 4, indices, 50, 3,
+                       Sampling::stratified);
+  for (size_t e = 0; e < 3; e++) {
+    sampler.set_epoch(e);
+    auto sorted = order(sampler);
+    std::ranges::sort(sorted);
+    EXPECT_EQ(sorted, indices);
+    for (size_t b = 0; b < sampler.num_batches(); b++) {
+      const auto batch = sampler.batch(b);
+      std::vector<double> counts(3, 0);
+      for (size_t i = 0; i < batch.size(); i++) ++counts[batch.label(i)];
+      EXPECT_NEAR(counts[0], 30, 1.0);
+      EXPECT_NEAR(counts[1], 15, 1.0);
+      EXPECT_NEAR(counts[2], 5, 1.0);
+    }
+  }
+}
+
+TEST_F(BatchSamplerTest, Weighted) {
+  // by default classes are drawn equally often
+  BatchSampler balanced(images.data(), labels, 4, indices, 100, 5,
+                        Sampling::weighted);
+  std::vector<double> counts(3, 0);
+  for (const auto i : order(balanced)) ++counts[labels[i]];
+  for (const auto c : counts) EXPECT_NEAR(c/1000, 1.0/3, 0.05);
+
+  BatchSampler only_two(images.data(), labels, 4, indices, 100, 5,
+                        Sampling::weighted, {0, 0, 1});
+  for (const auto i : order(only_two)) EXPECT_EQ(labels[i], 2);
+
+  EXPECT_THROW(BatchSampler(images.data(), labels, 4, indices, 100, 5,
+                            Sampling::weighted, {1, 1}),
+               std::invalid_argument);
+  EXPECT_THROW(BatchSampler(images.data(), labels, 4, indices, 0, 5),
+               std::invalid_argument);
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "../include/batch_view.hpp"
+#include "../include/components.hpp"
+#include "../include/losses.hpp"
+
+class BatchViewTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> pixel(0, 255);
+    std::uniform_int_distribution<int> label(0, 3);
+    images.resize(12*6);
+    for (auto &p : images) p = static_cast<uint8_t>(pixel(gen));
+    for (size_t i = 0; i < 12; i++)
+      labels.emplace_back(static_cast<uint8_t>(label(gen)));
+  }
+
+  /* The samples of view as DataHandler/extract would hand them out */
+  std::pair<std::vector<std::vector<double>>, std::vector<uint8_t>>
+  copy(const BatchView &view) const {
+    std::vector<std::vector<double>> inputs;
+    std::vector<uint8_t> targets;
+    for (size_t i = 0; i < view.size(); i++) {
+      const auto *img = images.data() + view.index(i)*6;
+      inputs.emplace_back(img, img + 6);
+      for (auto &x : inputs.back()) x /= 255.0;
+      targets.emplace_back(labels[view.index(i)]);
+    }
+    return {inputs, targets};
+  }
+
+  std::vector<uint8_t> images;
+  std::vector<uint8_t> labels;
+  const std::vector<size_t> indices{7, 2, 11, 0, 5, 9};
+  const std::shared_ptr<const MLP<double>> model =
+      std::make_shared<MLP<double>>(std::vector<Layer<double>>{
+          Layer<double>{6, 5, UnaryOp::relu},
+          Layer<double>{5, 4, UnaryOp::softmax}});
+};
+
+TEST_F(BatchViewTest, ContiguousAndIndexed) {
+  const BatchView range(images.data(), labels.data(), 6, 3, 4);
+  const BatchView picked(images.data(), labels.data(), 6, indices);
+  EXPECT_TRUE(range.contiguous());
+  EXPECT_FALSE(picked.contiguous());
+  EXPECT_EQ(range.index(2), 5);
+  EXPECT_EQ(picked.index(2), 11);
+  EXPECT_EQ(picked.image(1), images.data() + 12);
+
+  std::vector<uint8_t> scratch;
+  const auto range_labels = range.labels(scratch);
+  EXPECT_EQ(range_labels.data(), labels.data() + 3);
+  const auto picked_labels = picked.labels(scratch);
+  for (size_t i = 0; i < indices.size(); i++)
+    EXPECT_EQ(picked_labels[i], labels[indices[i]]);
+
+  std::vector<float> rows(picked.size()*6);
+  picked.gather(rows.data(), PixelScale<float>{1, 0});
+  for (size_t i = 0; i < picked.size(); i++)
+    for (size_t j = 0; j < 6; j++)
+      EXPECT_EQ(rows[i*6 + j], images[indices[i]*6 + j]);
+
+  const auto sub = picked.subview(1, 4);
+  EXPECT_EQ(sub.size(), 3);
+  EXPECT_EQ(sub.index(0), 2);
+  EXPECT_EQ(range.subview(1, 3).index(0), 4);
+  EXPECT_EQ(picked.shard(1, 4).size(), 2);
+  EXPECT_EQ(picked.shard(1, 4).index(1), 11);
+  EXPECT_THROW((void) picked.subview(2, 7), std::out_of_range);
+}
+
+TEST_F(BatchViewTest, LossMatchesCopies) {
+  const BatchView view(images.data(), labels.data(), 6, indices);
+  const auto [inputs, targets] = copy(view);
+  const auto &grad = model->get_parameters()[0].grad;
+
+  SparseCCELoss<double> sparse(model);
+  sparse.compute_loss(inputs, targets);
+  sparse.backward();
+  const double expected = sparse.get();
+  const std::vector<double> expected_grad(grad.begin(), grad.end());
+  model->zero_grad();
+  sparse.zero();
+
+  sparse.compute_loss(view);
+  EXPECT_NEAR(sparse.get(), expected, 1e-12);
+  sparse.backward();
+  for (size_t i = 0; i < grad.size(); i++)
+    EXPECT_NEAR(grad[i], expected_grad[i], 1e-12);
+  model->zero_grad();
+
+  sparse.stream_backward(view, 4);
+  EXPECT_NEAR(sparse.get(), expected, 1e-12);
+  for (size_t i = 0; i < grad.size(); i++)
+    EXPECT_NEAR(grad[i], expected_grad[i], 1e-12);
+  model->zero_grad();
+
+  // the scalar path converts one sample at a time
+  MSELoss<double> mse(model);
+  mse.compute_loss(inputs, targets);
+  const double expected_mse = mse.get();
+  mse.zero();
+  mse.compute_loss(view);
+  EXPECT_NEAR(mse.get(), expected_mse, 1e-12);
+}
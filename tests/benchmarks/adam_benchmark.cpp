@@ -0,0 +1,72 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include "../../include/components.hpp"
+#include "../../include/optimiser.hpp"
+
+/* The former three-pass update (clip, moments, weights), for comparison */
+void three_pass_step(const Parameter<double> &p,
+                     std::vector<double> &m, std::vector<double> &v,
+                     const size_t t) {
+  const double beta_1 = 0.9, beta_2 = 0.999, eps = 1e-8, step_size = 1e-3;
+  std::ranges::transform(p.grad, p.grad.begin(), [](const double g) {
+    return std::clamp(g, -1.0, 1.0);
+  });
+  size_t idx = 0;
+  for (const double g : p.grad) {
+    m[idx] = beta_1*m[idx] + (1 - beta_1)*g;
+    v[idx] = beta_2*v[idx] + (1 - beta_2)*std::pow(g, 2);
+    ++idx;
+  }
+  const auto alpha_t = step_size*std::sqrt(1 - std::pow(beta_2, t))/
+      (1 - std::pow(beta_1, t));
+  const double eps_p = eps*std::sqrt(1 - std::pow(beta_2, t));
+  idx = 0;
+  for (double &w : p.data) {
+    w -= alpha_t*m[idx]/(std::sqrt(v[idx]) + eps_p);
+    ++idx;
+  }
+}
+
+template <class Func>
+double best_ms(const size_t repeats, Func f) {
+  double best = std::numeric_limits<double>::max();
+  for (size_t r = 0; r < repeats; r++) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+    const std::chrono::duration<double, std::milli> elapsed = end - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+/* One Adam step over a single 1000-input layer of about num_params
+ * parameters with non-zero grads */
+void run(const size_t num_params) {
+  const size_t nout = std::max<size_t>(1, num_params/1001);
+  const auto model = std::make_shared<const MLP<double>>(
+      std::vector<Layer<double>>{Layer<double>(1000, nout, UnaryOp::relu)});
+  const auto &p = model->get_parameters()[0];
+  for (size_t i = 0; i < p.grad.size(); i++)
+    p.grad[i] = 1e-3*static_cast<double>(i%17) - 5e-3;
+  Adam<double> adam(model);
+  std::vector<double> m(p.data.size()), v(p.data.size());
+  size_t t = 0;
+
+  const double fused = best_ms(10, [&] { adam.step(); });
+  const double three_pass = best_ms(10, [&] { three_pass_step(p, m, v, ++t); });
+  auto &pool = ThreadPool::global();
+  adam.set_thread_pool(&pool);
+  const double sharded = best_ms(10, [&] { adam.step(); });
+  std::cout << p.data.size() << " params: fused " << fused
+            << " ms, three-pass " << three_pass << " ms ("
+            << three_pass/fused << "x), sharded over "
+            << pool.num_workers() + 1 << " threads " << sharded << " ms\n";
+}
+
+int main() {
+  for (const size_t n : {10'000, 100'000, 1'000'000, 10'000'000}) run(n);
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include "../../include/components.hpp"
+#include "../../include/losses.hpp"
+#include "../../include/optimiser.hpp"
+#include "../../include/trainer.hpp"
+
+/* MNIST-shaped stand-in (784 features in [0, 1], 10 classes): every class
+ * shares a common background and differs by a faint sparse prototype;
+ * samples add heavy pixel noise */
+struct Synthetic {
+  std::vector<std::vector<std::vector<double>>> batches;
+  std::vector<std::vector<uint8_t>> batch_targets;
+  std::vector<std::vector<double>> eval;
+  std::vector<uint8_t> eval_targets;
+};
+
+Synthetic make_data(const size_t num_batches, const size_t batch_size,
+                    const size_t num_eval) {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> unit(0, 1);
+  std::vector<double> background(784);
+  for (auto &x : background) x = unit(gen) < 0.3 ? unit(gen) : 0.0;
+  std::vector<std::vector<double>> protos(10, background);
+  for (auto &p : protos)
+    for (auto &x : p) x += unit(gen) < 0.1 ? 0.15*unit(gen) : 0.0;
+  auto sample = [&](const uint8_t label) {
+    std::vector<double> x(protos[label]);
+    for (auto &v : x) v = std::clamp(v + 0.6*(unit(gen) - 0.5), 0.0, 1.0);
+    return x;
+  };
+  Synthetic data;
+  std::uniform_int_distribution<int> label(0, 9);
+  for (size_t b = 0; b < num_batches; b++) {
+    data.batches.emplace_back();
+    data.batch_targets.emplace_back();
+    for (size_t i = 0; i < batch_size; i++) {
+      const auto y = static_cast<uint8_t>(label(gen));
+      data.batches.back().emplace_back(sample(y));
+      data.batch_targets.back().emplace_back(y);
+    }
+  }
+  for (size_t i = 0; i < num_eval; i++) {
+    const auto y = static_cast<uint8_t>(label(gen));
+    data.eval.emplace_back(sample(y));
+    data.eval_targets.emplace_back(y);
+  }
+  return data;
+}
+
+int main() {
+  const auto data = make_data(300, 100, 2000);
+  const MLP<double> init({Layer<double>{784, 32, UnaryOp::relu},
+                          Layer<double>{32, 10, UnaryOp::softmax}});
+  const std::pair<StatePrecision, const char *> states[] = {
+      {StatePrecision::float64, "float64"},
+      {StatePrecision::float32, "float32"},
+      {StatePrecision::bfloat16, "bfloat16"}};
+
+  std::cout << std::fixed << std::setprecision(4);
+  for (const auto &[state, name] : states) {
+    const std::shared_ptr<const MLP<double>> model =
+        std::make_shared<MLP<double>>(init);
+    Adam<double> adam(model, 1e-3, 0.9, 0.999, 1e-8, 1.0, state);
+    SparseCCELoss<double> loss(model);
+    std::cout << name << " (state " << adam.state_bytes()/1024
+              << " KiB) loss every 50 batches:";
+    double window = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < data.batches.size(); b++) {
+      train_single_batch(model, data.batches[b], data.batch_targets[b],
+                         loss, adam);
+      window += loss.get();
+      loss.zero();
+      if ((b + 1)%50==0) {
+        std::cout << ' ' << window/50;
+        window = 0;
+      }
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << ", accuracy "
+              << model->predict_batch(data.eval, data.eval_targets).accuracy
+              << ", " << elapsed.count() << " s\n";
+  }
+  return 0;
+}
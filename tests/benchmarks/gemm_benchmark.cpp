@@ -0,0 +1,58 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../../include/layer.hpp"
+#include "../../include/gemm.hpp"
+
+/* Best-of-repeats GFLOP/s of f, which performs flops floating point ops */
+template <class Func>
+double gflops(const double flops, const size_t repeats, Func f) {
+  double best = std::numeric_limits<double>::max();
+  for (size_t r = 0; r < repeats; r++) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = end - start;
+    best = std::min(best, elapsed.count());
+  }
+  return flops/best*1e-9;
+}
+
+/* A batch x nin input through an nout x nin layer: the per-sample
+ * Neuron::predict loop the model used to evaluate with, against one
+ * X·Wᵀ GEMM per kernel */
+void run(const size_t batch, const size_t nin, const size_t nout) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(-1, 1);
+  std::vector<double> x(batch*nin), w(nout*nin), out(batch*nout);
+  for (auto &v : x) v = dist(gen);
+  for (auto &v : w) v = dist(gen);
+  Layer<double> layer(nin, nout, UnaryOp::relu);
+  const double flops = 2.0*static_cast<double>(batch*nin*nout);
+
+  std::cout << batch << 'x' << nin << " · (" << nout << 'x' << nin
+            << ")ᵀ: neuron loop "
+            << gflops(flops, 3, [&] {
+              for (size_t i = 0; i < batch; i++)
+                for (size_t j = 0; j < nout; j++)
+                  out[i*nout + j] = layer.neuron(j).predict(x.data() + i*nin);
+            });
+  for (const auto isa : {GemmIsa::scalar, GemmIsa::avx2, GemmIsa::avx512}) {
+    if (set_gemm_isa(isa)!=isa) continue;
+    std::cout << ", " << to_string(isa) << ' '
+              << gflops(flops, 5, [&] {
+                gemm(false, true, batch, nout, nin, x.data(), nin,
+                     w.data(), nin, out.data(), nout, false);
+              });
+  }
+  std::cout << " GFLOP/s\n";
+}
+
+int main() {
+  run(100, 784, 32);
+  run(256, 784, 256);
+  run(512, 1024, 1024);
+  run(1024, 2048, 2048);
+  return 0;
+}
@@ -0,0 +1,56 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include "../../include/components.hpp"
+#include "../../include/data_parallel.hpp"
+#include "../../include/hogwild.hpp"
+#include "../../include/losses.hpp"
+#include "../../include/optimiser.hpp"
+
+/* Sparse 784-feature inputs (about 1 in 8 pixels set, class-dependent),
+ * trained for a few epochs with Hogwild SGD and with synchronous
+ * data-parallel Adam on the same pool. Reports samples/s and accuracy. */
+int main() {
+  constexpr size_t samples = 4000;
+  constexpr size_t epochs = 3;
+  std::mt19937 gen(9);
+  std::bernoulli_distribution on(0.1);
+  std::vector<std::vector<double>> inputs(samples, std::vector<double>(784));
+  std::vector<uint8_t> targets(samples);
+  for (size_t i = 0; i < samples; i++) {
+    targets[i] = static_cast<uint8_t>(i%10);
+    for (size_t j = 0; j < 784; j++)
+      inputs[i][j] = on(gen) || j%10==targets[i] && j < 100 ? 1.0 : 0.0;
+  }
+
+  auto &pool = ThreadPool::global();
+  const auto make_model = [] {
+    return std::make_shared<const MLP<double>>(
+        std::vector<Layer<double>>{Layer<double>(784, 64, UnaryOp::relu),
+                                   Layer<double>(64, 10, UnaryOp::softmax)});
+  };
+
+  Hogwild<double, SparseCCELoss<double>> hogwild(make_model(), 1e-2);
+  for (size_t e = 0; e < epochs; e++)
+    std::cout << "Hogwild, " << hogwild.num_workers() << " workers, epoch "
+              << e + 1 << ": " << hogwild.train_epoch(inputs, targets,
+                                                     inputs, targets) << '\n';
+
+  constexpr size_t batch = 100;
+  const auto model = make_model();
+  Adam<double> adam(model);
+  DataParallel<double, SparseCCELoss<double>> sync(model);
+  for (size_t e = 0; e < epochs; e++) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < samples; b += batch)
+      sync.train_batch(std::span(inputs).subspan(b, batch),
+                       std::span(targets).subspan(b, batch), adam);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << "Synchronous, " << sync.num_replicas() << " replicas, epoch "
+              << e + 1 << ": " << samples/elapsed.count()
+              << " samples/s, accuracy "
+              << model->predict_batch(inputs, targets).accuracy << '\n';
+  }
+}
@@ -0,0 +1,55 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include "../../include/batch_sampler.hpp"
+#include "../../include/components.hpp"
+#include "../../include/idx_dataset.hpp"
+#include "../../include/losses.hpp"
+#include "../../include/optimiser.hpp"
+#include "../../include/prefetcher.hpp"
+#include "../../include/trainer.hpp"
+
+/* One epoch over the MNIST training set with shuffled batches, once
+ * gathering each batch on the training thread and once with a Prefetcher
+ * preparing them ahead. Reports samples/s and the pipeline's stats. */
+int main() {
+  const IdxDataset dataset("data/train-images-idx3-ubyte",
+                           "data/train-labels-idx1-ubyte");
+  const auto split = dataset.split(1, 1.0, 0.0);
+  BatchSampler sampler(dataset, split.training, 100, 1);
+  const auto make_model = [&] {
+    return std::make_shared<const MLP<float>>(std::vector<Layer<float>>{
+        Layer<float>(dataset.image_size(), 128, UnaryOp::relu),
+        Layer<float>(128, dataset.num_classes(), UnaryOp::softmax)});
+  };
+  const auto report = [&](const char *name, const auto start) {
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << name << ": " << dataset.size()/elapsed.count()
+              << " samples/s\n";
+  };
+
+  {
+    const auto model = make_model();
+    SparseCCELoss<float> loss(model);
+    Adam<float> adam(model);
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < sampler.num_batches(); b++)
+      train_single_batch(model, sampler.batch(b), loss, adam);
+    report("Gather on the training thread", start);
+  }
+  for (const size_t workers : {1, 2}) {
+    const auto model = make_model();
+    SparseCCELoss<float> loss(model);
+    Adam<float> adam(model);
+    Prefetcher<float> prefetcher(4, workers);
+    const auto start = std::chrono::steady_clock::now();
+    prefetcher.start(sampler.num_batches(), [&](const size_t i) {
+      return sampler.batch(i);
+    });
+    while (const auto *batch = prefetcher.next())
+      train_single_batch(model, *batch, loss, adam);
+    report(workers==1 ? "Prefetch, 1 worker" : "Prefetch, 2 workers", start);
+    std::cout << prefetcher.stats() << '\n';
+  }
+}
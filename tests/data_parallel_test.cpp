@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "../include/components.hpp"
+#include "../include/data_parallel.hpp"
+#include "../include/losses.hpp"
+#include "../include/optimiser.hpp"
+#include "../include/trainer.hpp"
+
+class DataParallelTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<double> dist(0, 1);
+    std::uniform_int_distribution<int> label(0, 3);
+    inputs.resize(50, std::vector<double>(20));
+    for (auto &input : inputs)
+      for (auto &x : input) x = dist(gen);
+    for (size_t i = 0; i < inputs.size(); i++)
+      targets.emplace_back(static_cast<uint8_t>(label(gen)));
+  }
+
+  /* Train reference and parallel copies of one model for a few batches
+   * and compare the losses and the parameters */
+  template <template <typename> class Loss>
+  void expect_matches_serial(const size_t replicas, const size_t micro_batch) {
+    const auto serial = std::make_shared<MLP<double>>(
+        std::vector<Layer<double>>{Layer<double>{20, 16, UnaryOp::relu},
+                                   Layer<double>{16, 4, UnaryOp::softmax}});
+    const auto parallel = std::make_shared<MLP<double>>(*serial);
+    Loss<double> serial_loss(serial);
+    Adam<double> serial_adam(serial, 1e-2);
+    Adam<double> parallel_adam(parallel, 1e-2);
+    DataParallel<double, Loss<double>> trainer(parallel, replicas, pool,
+                                               micro_batch);
+    ASSERT_EQ(trainer.num_replicas(), replicas);
+
+    for (size_t step = 0; step < 3; step++) {
+      train_single_batch(std::shared_ptr<const MLP<double>>(serial), inputs,
+                         targets, serial_loss, serial_adam);
+      trainer.train_batch(inputs, targets, parallel_adam);
+      EXPECT_NEAR(trainer.get(), serial_loss.get(), 1e-12);
+      serial_loss.zero();
+    }
+    const auto &expected = serial->get_parameters()[0].data;
+    const auto &actual = parallel->get_parameters()[0].data;
+    for (size_t i = 0; i < expected.size(); i++)
+      ASSERT_NEAR(actual[i], expected[i], 1e-9);
+    for (const auto g : parallel->get_parameters()[0].grad)
+      ASSERT_EQ(g, 0.0);
+  }
+
+  std::vector<std::vector<double>> inputs;
+  std::vector<uint8_t> targets;
+  ThreadPool pool{3};
+};
+
+TEST_F(DataParallelTest, TensorPathMatchesSerial) {
+  expect_matches_serial<SparseCCELoss>(4, 0);
+  expect_matches_serial<SparseCCELoss>(7, 3);
+  expect_matches_serial<SparseCCELoss>(1, 0);
+}
+
+TEST_F(DataParallelTest, ScalarPathMatchesSerial) {
+  expect_matches_serial<MSELoss>(4, 1);
+}
+
+TEST_F(DataParallelTest, MoreReplicasThanSamples) {
+  inputs.resize(3);
+  targets.resize(3);
+  expect_matches_serial<SparseCCELoss>(5, 0);
+}
+
+TEST_F(DataParallelTest, SharedParameters) {
+  const MLP<double> model{{Layer<double>{20, 4, UnaryOp::softmax}}};
+  MLP<double> replica(model);
+  replica.share_parameters(model);
+  model.get_parameters()[0].data[0] += 1.0;
+  EXPECT_EQ(replica.get_parameters()[0].data.data(),
+            model.get_parameters()[0].data.data());
+  EXPECT_NE(replica.get_parameters()[0].grad.data(),
+            model.get_parameters()[0].grad.data());
+  EXPECT_EQ(replica.predict(inputs[0]), model.predict(inputs[0]));
+
+  const MLP<double> other{{Layer<double>{20, 5, UnaryOp::softmax}}};
+  EXPECT_THROW(replica.share_parameters(other), std::invalid_argument);
+}
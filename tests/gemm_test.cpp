@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include "../include/gemm.hpp"
+
+class GemmTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    default_isa_ = gemm_isa();
+  }
+  void TearDown() override {
+    set_gemm_isa(default_isa_);
+  }
+
+  /* Triple loop over op(A)·op(B), accumulated in double */
+  template <typename T>
+  static std::vector<T> naive(const bool trans_a, const bool trans_b,
+                              const size_t m, const size_t n, const size_t k,
+                              const std::vector<T> &a,
+                              const std::vector<T> &b,
+                              const std::vector<T> &c) {
+    std::vector<T> out(c);
+    for (size_t i = 0; i < m; i++) {
+      for (size_t j = 0; j < n; j++) {
+        double sum = 0;
+        for (size_t p = 0; p < k; p++)
+          sum += static_cast<double>(trans_a ? a[p*m + i] : a[i*k + p])*
+                 static_cast<double>(trans_b ? b[j*k + p] : b[p*n + j]);
+        out[i*n + j] += static_cast<T>(sum);
+      }
+    }
+    return out;
+  }
+
+  /* Every transpose combination, accumulating into a non-zero C */
+  template <typename T>
+  void check(const size_t m, const size_t n, const size_t k, const T tol) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<T> dist(-1, 1);
+    std::vector<T> a(m*k), b(k*n), c(m*n);
+    for (auto &x : a) x = dist(gen);
+    for (auto &x : b) x = dist(gen);
+    for (auto &x : c) x = dist(gen);
+    for (const bool trans_a : {false, true}) {
+      for (const bool trans_b : {false, true}) {
+        const auto expected = naive(trans_a, trans_b, m, n, k, a, b, c);
+        auto out = c;
+        gemm(trans_a, trans_b, m, n, k,
+             a.data(), trans_a ? m : k, b.data(), trans_b ? k : n,
+             out.data(), n, true);
+        for (size_t i = 0; i < out.size(); i++)
+          ASSERT_NEAR(out[i], expected[i], tol)
+              << to_string(gemm_isa()) << " trans_a=" << trans_a
+              << " trans_b=" << trans_b << " at " << i;
+      }
+    }
+  }
+
+  static constexpr GemmIsa isas[] = {GemmIsa::scalar, GemmIsa::avx2,
+                                     GemmIsa::avx512};
+  GemmIsa default_isa_{GemmIsa::scalar};
+};
+
+TEST_F(GemmTest, SmallProblems) {
+  check<double>(1, 10, 784, 1e-10);
+  check<double>(3, 5, 7, 1e-12);
+}
+
+TEST_F(GemmTest, EveryKernelDouble) {
+  for (const auto isa : isas) {
+    if (set_gemm_isa(isa)!=isa) continue;
+    /* odd edges on every side and k spanning more than one cache block */
+    check<double>(37, 29, 300, 1e-10);
+    check<double>(150, 70, 16, 1e-12);
+  }
+}
+
+TEST_F(GemmTest, EveryKernelFloat) {
+  for (const auto isa : isas) {
+    if (set_gemm_isa(isa)!=isa) continue;
+    check<float>(37, 45, 300, 1e-3f);
+    check<float>(150, 70, 16, 1e-4f);
+  }
+}
+
+TEST_F(GemmTest, Overwrite) {
+  const std::vector<double> a{1, 2, 3, 4};
+  const std::vector<double> b{5, 6, 7, 8};
+  std::vector<double> c{100, 100, 100, 100};
+  gemm(false, false, 2, 2, 2, a.data(), 2, b.data(), 2, c.data(), 2, false);
+  EXPECT_DOUBLE_EQ(c[0], 19.0);
+  EXPECT_DOUBLE_EQ(c[1], 22.0);
+  EXPECT_DOUBLE_EQ(c[2], 43.0);
+  EXPECT_DOUBLE_EQ(c[3], 50.0);
+}
+
+/* 0·NaN in the products must give NaN whichever path runs the problem */
+TEST_F(GemmTest, NanPropagatesAtEverySize) {
+  for (const size_t size : {3, 64}) {
+    for (const bool trans_a : {false, true}) {
+      const std::vector<double> a(size*size, 0.0);
+      std::vector<double> b(size*size, 1.0);
+      b[0] = std::numeric_limits<double>::quiet_NaN();
+      std::vector<double> c(size*size, 0.0);
+      gemm(trans_a, false, size, size, size, a.data(), size,
+           b.data(), size, c.data(), size, false);
+      EXPECT_TRUE(std::isnan(c[0])) << size << ' ' << trans_a;
+      EXPECT_EQ(c[1], 0.0);
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "../include/components.hpp"
+#include "../include/hogwild.hpp"
+#include "../include/losses.hpp"
+
+class HogwildTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    /* sparse inputs, one hot feature per class plus noise features */
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> label(0, 3);
+    std::uniform_int_distribution<int> noise(4, 19);
+    for (size_t i = 0; i < 400; i++) {
+      const auto t = static_cast<uint8_t>(label(gen));
+      std::vector<double> x(20, 0.0);
+      x[t] = 1.0;
+      x[noise(gen)] = 1.0;
+      inputs.emplace_back(std::move(x));
+      targets.emplace_back(t);
+    }
+  }
+
+  std::shared_ptr<MLP<double>> make_model() const {
+    return std::make_shared<MLP<double>>(
+        std::vector<Layer<double>>{Layer<double>{20, 8, UnaryOp::relu},
+                                   Layer<double>{8, 4, UnaryOp::softmax}});
+  }
+
+  std::vector<std::vector<double>> inputs;
+  std::vector<uint8_t> targets;
+  ThreadPool pool{3};
+};
+
+/* A single worker is plain per-sample SGD */
+TEST_F(HogwildTest, OneWorkerIsSequentialSGD) {
+  const auto model = make_model();
+  const auto reference = std::make_shared<MLP<double>>(*model);
+  Hogwild<double, SparseCCELoss<double>> hogwild(model, 0.05, 1, pool);
+  const auto stats = hogwild.train_epoch(inputs, targets);
+  EXPECT_EQ(stats.samples, inputs.size());
+  EXPECT_GT(stats.samples_per_sec, 0.0);
+
+  SparseCCELoss<double> loss(reference);
+  const auto &p = reference->get_parameters()[0];
+  double total = 0;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    loss.compute_loss(inputs[i], targets[i]);
+    total += loss.get();
+    loss.backward();
+    for (size_t j = 0; j < p.data.size(); j++)
+      p.data[j] -= 0.05*std::clamp(p.grad[j], -1.0, 1.0);
+    reference->zero_grad();
+    loss.zero();
+    Tape<double>::get().reset();
+  }
+  EXPECT_NEAR(stats.loss, total/inputs.size(), 1e-9);
+  const auto &q = model->get_parameters()[0];
+  for (size_t j = 0; j < p.data.size(); j++)
+    ASSERT_NEAR(q.data[j], p.data[j], 1e-9);
+}
+
+TEST_F(HogwildTest, ConcurrentWorkersLearn) {
+  const auto model = make_model();
+  Hogwild<double, SparseCCELoss<double>> hogwild(model, 0.05, 4, pool);
+  EXPECT_EQ(hogwild.num_workers(), 4);
+  HogwildStats first, last;
+  for (size_t e = 0; e < 5; e++) {
+    last = hogwild.train_epoch(inputs, targets, inputs, targets);
+    if (e==0) first = last;
+  }
+  EXPECT_LT(last.loss, first.loss);
+  EXPECT_GT(last.accuracy, 0.9);
+  for (const auto g : model->get_parameters()[0].grad) ASSERT_EQ(g, 0.0);
+}
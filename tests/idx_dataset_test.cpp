@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include "../include/batch_view.hpp"
+#include "../include/idx_dataset.hpp"
+
+class IdxDatasetTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/micrograd-idx-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    image_path = std::string(dir) + "/images";
+    label_path = std::string(dir) + "/labels";
+    dir_ = dir;
+    for (size_t i = 0; i < 5*2*3; i++) pixels.emplace_back(i*7%256);
+    write(image_path, {0x803, 5, 2, 3}, pixels);
+    write(label_path, {0x801, 5}, labels);
+  }
+  void TearDown() override {
+    std::remove(image_path.c_str());
+    std::remove(label_path.c_str());
+    rmdir(dir_.c_str());
+  }
+
+  static void write(const std::string &path,
+                    const std::vector<uint32_t> &header,
+                    const std::vector<uint8_t> &body) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    for (const auto h : header) {
+      const char bytes[4] = {static_cast<char>(h >> 24),
+                             static_cast<char>(h >> 16),
+                             static_cast<char>(h >> 8),
+                             static_cast<char>(h)};
+      file.write(bytes, 4);
+    }
+    file.write(reinterpret_cast<const char *>(body.data()),
+               static_cast<long>(body.size()));
+  }
+
+  std::string dir_;
+  std::string image_path;
+  std::string label_path;
+  std::vector<uint8_t> pixels;
+  std::vector<uint8_t> labels{3, 0, 3, 1, 0};
+};
+
+TEST_F(IdxDatasetTest, ViewsIntoTheFiles) {
+  const IdxDataset ds(image_path, label_path);
+  ASSERT_EQ(ds.size(), 5);
+  EXPECT_EQ(ds.rows(), 2);
+  EXPECT_EQ(ds.cols(), 3);
+  ASSERT_EQ(ds.image_size(), 6);
+  ASSERT_EQ(ds.images().size(), pixels.size());
+  EXPECT_TRUE(std::ranges::equal(ds.images(), pixels));
+  EXPECT_EQ(ds.image(3).data(), ds.images().data() + 18);
+  EXPECT_EQ(ds.image(3)[1], pixels[19]);
+  EXPECT_TRUE(std::ranges::equal(ds.labels(), labels));
+  EXPECT_EQ(ds.label(3), 1);
+  EXPECT_EQ(ds.class_counts(), (std::vector<size_t>{2, 1, 0, 2}));
+  EXPECT_EQ(ds.num_classes(), 4);
+}
+
+TEST_F(IdxDatasetTest, Move) {
+  IdxDataset ds(image_path, label_path);
+  const auto *data = ds.images().data();
+  const IdxDataset moved(std::move(ds));
+  EXPECT_EQ(moved.images().data(), data);
+  EXPECT_EQ(moved.size(), 5);
+  EXPECT_EQ(moved.num_classes(), 4);
+  EXPECT_TRUE(ds.images().empty());
+  EXPECT_EQ(ds.num_classes(), 0);
+}
+
+TEST_F(IdxDatasetTest, RejectsBadFiles) {
+  EXPECT_THROW(IdxDataset(image_path + "-missing", label_path),
+               std::runtime_error);
+  // labels where images are expected
+  EXPECT_THROW(IdxDataset(label_path, label_path), std::runtime_error);
+  write(label_path, {0x801, 4}, {3, 0, 3, 1});
+  EXPECT_THROW(IdxDataset(image_path, label_path), std::runtime_error);
+  write(label_path, {0x801, 5}, labels);
+  write(image_path, {0x803, 5, 2, 3}, {pixels.begin(), pixels.end() - 1});
+  EXPECT_THROW(IdxDataset(image_path, label_path), std::runtime_error);
+  // zero-sized images, whose file is just the header
+  write(image_path, {0x803, 5, 0, 3}, {});
+  EXPECT_THROW(IdxDataset(image_path, label_path), std::runtime_error);
+}
+
+TEST_F(IdxDatasetTest, SplitAndBatches) {
+  const IdxDataset ds(image_path, label_path);
+  const auto split = ds.split(3, 0.6, 0.2);
+  EXPECT_EQ(split.training.size(), 3);
+  EXPECT_EQ(split.validation.size(), 1);
+  EXPECT_EQ(split.test.size(), 1);
+  EXPECT_EQ(ds.split(3, 0.6, 0.2).training, split.training);
+
+  const auto batches = make_batches(ds, split.training, 2);
+  ASSERT_EQ(batches.size(), 2);
+  EXPECT_EQ(batches[0].index(1), split.training[1]);
+  EXPECT_EQ(batches[1].size(), 1);
+  EXPECT_EQ(batches[0].label(0), labels[split.training[0]]);
+  EXPECT_EQ(batches[0].image(0), ds.image(split.training[0]).data());
+
+  const auto shards = make_batches(ds, split.training, 2, 1, 2);
+  EXPECT_EQ(shards[0].size(), 1);
+  EXPECT_EQ(shards[0].index(0), split.training[1]);
+  EXPECT_THROW(BatchView(ds, 4, 2), std::out_of_range);
+}
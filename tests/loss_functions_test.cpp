@@ -117,4 +117,103 @@ TEST_F(LossFunctionsTest, test_batched_mse) {
               mse_loss,
               adam,
               epochs);
-}
\ No newline at end of file
+}
+
+TEST_F(LossFunctionsTest, test_batched_matches_per_sample) {
+  // the batch goes through the tensor path, single samples through scalars
+  sparse_cce_loss.compute_loss(batched_input, batched_sparse_tgt);
+  const double batched = sparse_cce_loss.get();
+  sparse_cce_loss.backward();
+  std::vector<double> batched_grads;
+  for (const auto &p : mp->get_parameters())
+    batched_grads.insert(batched_grads.end(), p.grad.begin(), p.grad.end());
+  mp->zero_grad();
+  sparse_cce_loss.zero();
+
+  double per_sample = 0;
+  for (size_t i = 0; i < batched_input.size(); i++) {
+    cce_loss.compute_loss(batched_input[i], batched_categorical_tgt[i]);
+    per_sample += cce_loss.get();
+    cce_loss.zero();
+  }
+  EXPECT_NEAR(batched, per_sample/batched_input.size(), 1e-9);
+
+  cce_loss.compute_loss(batched_input, batched_categorical_tgt);
+  EXPECT_NEAR(cce_loss.get(), batched, 1e-12);
+  cce_loss.backward();
+  size_t i = 0;
+  for (const auto &p : mp->get_parameters())
+    for (const auto g : p.grad)
+      EXPECT_NEAR(g, batched_grads[i++], 1e-12);
+}
+
+/* Streaming micro-batches must reproduce the whole-batch loss and grads on
+ * both the tensor path (sparse and one-hot CCE) and the scalar path (MSE) */
+TEST_F(LossFunctionsTest, StreamBackwardMatchesBatch) {
+  const auto &grad = mp->get_parameters()[0].grad;
+  auto check = [&](auto &loss, const auto &targets) {
+    loss.compute_loss(batched_input, targets);
+    loss.backward();
+    const double expected_loss = loss.get();
+    const std::vector<double> expected(grad.begin(), grad.end());
+    for (const size_t micro_batch : {1, 2, 5}) {
+      mp->zero_grad();
+      loss.zero();
+      Tape<double>::get().reset();
+      TensorTape<double>::get().reset();
+      loss.stream_backward(batched_input, targets, micro_batch);
+      EXPECT_NEAR(loss.get(), expected_loss, 1e-12);
+      for (size_t i = 0; i < expected.size(); i++)
+        EXPECT_NEAR(grad[i], expected[i], 1e-12);
+    }
+    mp->zero_grad();
+    loss.zero();
+  };
+  check(sparse_cce_loss, batched_sparse_tgt);
+  check(cce_loss, batched_categorical_tgt);
+  check(mse_loss, batched_sparse_tgt);
+  EXPECT_THROW(sparse_cce_loss.stream_backward(batched_input,
+                                               batched_sparse_tgt, 0),
+               std::invalid_argument);
+}
+
+TEST_F(LossFunctionsTest, BatchLossFromPixels) {
+  const std::vector<uint8_t> pixels{255, 0, 0, 0, 255, 0, 0, 0, 255};
+  const auto inputs = TensorValue<double>::from_pixels(pixels.data(), 3, 3);
+  EXPECT_DOUBLE_EQ(inputs.get_data(1, 1), 1.0);
+  EXPECT_DOUBLE_EQ(inputs.get_data(1, 2), 0.0);
+
+  sparse_cce_loss.compute_loss(batched_input, batched_sparse_tgt);
+  const double expected = sparse_cce_loss.get();
+  sparse_cce_loss.compute_loss(inputs, batched_sparse_tgt);
+  EXPECT_NEAR(sparse_cce_loss.get(), expected, 1e-12);
+  cce_loss.compute_loss(inputs, batched_sparse_tgt);
+  EXPECT_NEAR(cce_loss.get(), expected, 1e-12);
+
+  // an offset shifts every input
+  const auto shifted = TensorValue<double>::from_pixels(
+      pixels.data(), 3, 3, {2.0/255, -1.0});
+  EXPECT_DOUBLE_EQ(shifted.get_data(0, 0), 1.0);
+  EXPECT_DOUBLE_EQ(shifted.get_data(0, 1), -1.0);
+}
+
+TEST_F(LossFunctionsTest, BackwardFollowsLastPath) {
+  // a batch, then a step that resets the tapes, without zero()
+  sparse_cce_loss.compute_loss(batched_input, batched_sparse_tgt);
+  sparse_cce_loss.backward();
+  adam.step();
+  mp->zero_grad();
+
+  const auto fresh_model = std::make_shared<MLP<double>>(*mp);
+  SparseCCELoss<double> fresh(fresh_model);
+  fresh.compute_loss(input1, tgt1);
+  fresh.backward();
+  sparse_cce_loss.compute_loss(input1, tgt1);
+  EXPECT_NEAR(sparse_cce_loss.get(), fresh.get(), 1e-12);
+  sparse_cce_loss.backward();
+  const auto &grad = mp->get_parameters()[0].grad;
+  const auto &expected = fresh_model->get_parameters()[0].grad;
+  EXPECT_TRUE(std::ranges::any_of(grad, [](const double g) { return g!=0.0; }));
+  for (size_t i = 0; i < grad.size(); i++)
+    EXPECT_NEAR(grad[i], expected[i], 1e-12);
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <random>
+#include "../include/components.hpp"
+
+class ModelTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> dist(0, 1);
+    std::uniform_int_distribution<int> label(0, 3);
+    inputs.resize(300, std::vector<double>(20));
+    for (auto &input : inputs)
+      for (auto &x : input) x = dist(gen);
+    for (size_t i = 0; i < inputs.size(); i++)
+      targets.emplace_back(static_cast<uint8_t>(label(gen)));
+  }
+
+  MLP<double> model{{Layer<double>{20, 16, UnaryOp::relu},
+                     Layer<double>{16, 4, UnaryOp::softmax}}};
+  std::vector<std::vector<double>> inputs;
+  std::vector<uint8_t> targets;
+  ThreadPool pool{3};
+};
+
+TEST_F(ModelTest, PredictBatchMatchesPredict) {
+  const auto result = model.predict_batch(inputs, targets, true, pool);
+  ASSERT_EQ(result.labels.size(), inputs.size());
+  size_t correct = 0;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    EXPECT_EQ(result.labels[i], model.predict(inputs[i]));
+    correct += result.labels[i]==targets[i];
+  }
+  EXPECT_DOUBLE_EQ(result.accuracy,
+                   static_cast<double>(correct)/inputs.size());
+
+  ASSERT_EQ(result.num_classes, 4);
+  size_t total = 0, diagonal = 0;
+  for (size_t t = 0; t < 4; t++) {
+    for (size_t p = 0; p < 4; p++) total += result.confusion_at(t, p);
+    diagonal += result.confusion_at(t, t);
+  }
+  EXPECT_EQ(total, inputs.size());
+  EXPECT_EQ(diagonal, correct);
+}
+
+TEST_F(ModelTest, PredictBatchWithoutTargets) {
+  const auto result = model.predict_batch(inputs, {}, true, pool);
+  EXPECT_EQ(result.labels.size(), inputs.size());
+  EXPECT_TRUE(result.confusion.empty());
+  EXPECT_DOUBLE_EQ(result.accuracy, 0.0);
+}
+
+TEST_F(ModelTest, PredictBatchChecksSizes) {
+  inputs[123].pop_back();
+  EXPECT_THROW(model.predict_batch(inputs, targets, false, pool),
+               std::invalid_argument);
+  targets.pop_back();
+  EXPECT_THROW(model.predict_batch(inputs, targets), std::invalid_argument);
+}
+
+TEST_F(ModelTest, FlatParameterArena) {
+  const auto params = model.get_parameters();
+  ASSERT_EQ(params.size(), 1);
+  EXPECT_EQ(params[0].data.size(), 16*21 + 4*17);
+  EXPECT_EQ(params[0].grad.size(), params[0].data.size());
+
+  // backward accumulates straight into the arena, zero_grad clears it
+  const auto out = model(inputs[0]);
+  auto sum = out[0];
+  for (size_t i = 1; i < out.size(); i++) sum += out[i]*out[i];
+  sum.backward();
+  EXPECT_TRUE(std::ranges::any_of(params[0].grad,
+                                  [](const double g) { return g!=0.0; }));
+  model.zero_grad();
+  EXPECT_TRUE(std::ranges::all_of(params[0].grad,
+                                  [](const double g) { return g==0.0; }));
+
+  // a copy gets its own arena
+  const MLP<double> copy(model);
+  std::ranges::fill(params[0].data, 0.0);
+  EXPECT_NE(copy.get_parameters()[0].data.data(), params[0].data.data());
+  EXPECT_TRUE(std::ranges::any_of(copy.get_parameters()[0].data,
+                                  [](const double w) { return w!=0.0; }));
+}
+
+TEST_F(ModelTest, PredictBatchFromPixels) {
+  std::vector<uint8_t> pixels;
+  for (auto &input : inputs) {
+    for (auto &x : input) {
+      pixels.emplace_back(static_cast<uint8_t>(x*255));
+      x = pixels.back()/255.0;
+    }
+  }
+  const auto expected = model.predict_batch(inputs, targets, true, pool);
+  const auto result = model.predict_batch(pixels, targets, {}, true, pool);
+  EXPECT_EQ(result.labels, expected.labels);
+  EXPECT_EQ(result.confusion, expected.confusion);
+  EXPECT_DOUBLE_EQ(result.accuracy, expected.accuracy);
+
+  pixels.pop_back();
+  EXPECT_THROW(model.predict_batch(pixels, targets), std::invalid_argument);
+}
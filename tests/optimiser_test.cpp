@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include "../include/components.hpp"
+#include "../include/optimiser.hpp"
+
+class OptimiserTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    const auto &p = model->get_parameters()[0];
+    for (size_t i = 0; i < p.grad.size(); i++)
+      p.grad[i] = 0.37*std::sin(static_cast<double>(i)) *
+          (i%5==0 ? 10.0 : 1.0);
+  }
+
+  /* 3 x 7 + 7 = 28 parameters, so the vector kernels leave a scalar tail */
+  const std::shared_ptr<const MLP<double>> model =
+      std::make_shared<MLP<double>>(
+          std::vector<Layer<double>>{Layer<double>(3, 7, UnaryOp::relu)});
+};
+
+TEST_F(OptimiserTest, AdamMatchesReference) {
+  const auto &p = model->get_parameters()[0];
+  std::vector<double> w(p.data.begin(), p.data.end());
+  std::vector<double> m(w.size(), 0), v(w.size(), 0);
+  Adam<double> adam(model, 1e-2);
+
+  for (size_t t = 1; t <= 3; t++) {
+    const double alpha_t = 1e-2*std::sqrt(1 - std::pow(0.999, t))/
+        (1 - std::pow(0.9, t));
+    const double eps_p = 1e-8*std::sqrt(1 - std::pow(0.999, t));
+    for (size_t i = 0; i < w.size(); i++) {
+      const double g = std::clamp(p.grad[i], -1.0, 1.0);
+      m[i] = 0.9*m[i] + (1 - 0.9)*g;
+      v[i] = 0.999*v[i] + (1 - 0.999)*(g*g);
+      w[i] -= alpha_t*m[i]/(std::sqrt(v[i]) + eps_p);
+    }
+    adam.step();
+    for (size_t i = 0; i < w.size(); i++) EXPECT_DOUBLE_EQ(p.data[i], w[i]);
+  }
+}
+
+/* The vector kernels must reproduce the scalar one exactly, tail included */
+TEST_F(OptimiserTest, EveryKernelIsBitIdentical) {
+  const auto initial = std::make_shared<const MLP<double>>(*model);
+  auto run = [&](const AdamIsa isa) {
+    const auto copy = std::make_shared<MLP<double>>(*initial);
+    const auto &p = copy->get_parameters()[0];
+    std::copy(model->get_parameters()[0].grad.begin(),
+              model->get_parameters()[0].grad.end(), p.grad.begin());
+    const auto selected = adam_isa();
+    set_adam_isa(isa);
+    Adam<double> adam(copy, 1e-2);
+    for (size_t t = 0; t < 5; t++) adam.step();
+    set_adam_isa(selected);
+    return std::vector<double>(p.data.begin(), p.data.end());
+  };
+  const auto expected = run(AdamIsa::scalar);
+  for (const auto isa : {AdamIsa::avx2, AdamIsa::avx512})
+    EXPECT_EQ(run(isa), expected) << static_cast<int>(isa);
+}
+
+TEST_F(OptimiserTest, ZeroGrad) {
+  Adam<double> adam(model);
+  adam.zero_grad();
+  for (const auto g : model->get_parameters()[0].grad) EXPECT_EQ(g, 0.0);
+}
+
+TEST_F(OptimiserTest, ShardedAdamIsBitIdentical) {
+  const auto serial_model = std::make_shared<MLP<double>>(
+      std::vector<Layer<double>>{Layer<double>(200, 301, UnaryOp::relu)});
+  const auto sharded_model = std::make_shared<MLP<double>>(*serial_model);
+  Adam<double> serial(serial_model);
+  Adam<double> sharded(sharded_model);
+  ThreadPool pool(3);
+  sharded.set_thread_pool(&pool);
+
+  const auto &a = serial_model->get_parameters()[0];
+  const auto &b = sharded_model->get_parameters()[0];
+  ASSERT_GT(a.data.size(), 2*Adam<double>::MIN_SHARD);
+  for (size_t t = 0; t < 3; t++) {
+    for (size_t i = 0; i < a.grad.size(); i++)
+      a.grad[i] = b.grad[i] = std::cos(static_cast<double>(i*(t + 1)));
+    serial.step();
+    sharded.step();
+    ASSERT_TRUE(std::ranges::equal(a.data, b.data));
+  }
+}
+
+TEST(BFloat16Test, Rounding) {
+  EXPECT_EQ(static_cast<float>(bfloat16(1.0f)), 1.0f);
+  EXPECT_EQ(static_cast<float>(bfloat16(-0.15625f)), -0.15625f);
+  // 1 + 2^-8 is halfway between 1 and 1 + 2^-7: ties go to even
+  EXPECT_EQ(static_cast<float>(bfloat16(1.00390625f)), 1.0f);
+  EXPECT_EQ(static_cast<float>(bfloat16(1.01171875f)), 1.015625f);
+  EXPECT_TRUE(std::isnan(static_cast<float>(bfloat16(std::nanf("")))));
+
+  // stochastic rounding is unbiased: 1 + 2^-10 rounds up a quarter of the time
+  double sum = 0;
+  for (uint32_t r = 0; r < 65536; r++)
+    sum += static_cast<float>(bfloat16::stochastic(
+        1.0009765625f, static_cast<uint16_t>(r)));
+  EXPECT_DOUBLE_EQ(sum/65536, 1.0009765625);
+}
+
+TEST_F(OptimiserTest, ReducedPrecisionState) {
+  const auto &p = model->get_parameters()[0];
+  const std::vector<double> grads(p.grad.begin(), p.grad.end());
+  std::vector<std::vector<double>> weights;
+  for (const auto state : {StatePrecision::float64, StatePrecision::float32,
+                           StatePrecision::bfloat16}) {
+    const auto copy = std::make_shared<MLP<double>>(*model);
+    Adam<double> adam(copy, 1e-2, 0.9, 0.999, 1e-8, 1.0, state);
+    EXPECT_EQ(adam.state_precision(), state);
+    const auto &q = copy->get_parameters()[0];
+    for (size_t t = 0; t < 20; t++) {
+      std::ranges::copy(grads, q.grad.begin());
+      adam.step();
+    }
+    weights.emplace_back(q.data.begin(), q.data.end());
+  }
+  const size_t n = p.data.size();
+  EXPECT_EQ(Adam<double>(model).state_bytes(), 2*n*sizeof(double));
+  EXPECT_EQ(Adam<double>(model, 1e-3, 0.9, 0.999, 1e-8, 1.0,
+                         StatePrecision::bfloat16).state_bytes(), 2*n*2);
+  // 20 steps of 1e-2 move the weights by up to 0.2
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_NEAR(weights[1][i], weights[0][i], 1e-6);
+    EXPECT_NEAR(weights[2][i], weights[0][i], 2e-3);
+  }
+}
+
+TEST_F(OptimiserTest, ShardedBFloat16IsBitIdentical) {
+  const auto serial_model = std::make_shared<MLP<double>>(
+      std::vector<Layer<double>>{Layer<double>(200, 301, UnaryOp::relu)});
+  const auto sharded_model = std::make_shared<MLP<double>>(*serial_model);
+  Adam<double> serial(serial_model, 1e-3, 0.9, 0.999, 1e-8, 1.0,
+                      StatePrecision::bfloat16);
+  Adam<double> sharded(sharded_model, 1e-3, 0.9, 0.999, 1e-8, 1.0,
+                       StatePrecision::bfloat16);
+  ThreadPool pool(3);
+  sharded.set_thread_pool(&pool);
+  const auto &a = serial_model->get_parameters()[0];
+  const auto &b = sharded_model->get_parameters()[0];
+  for (size_t t = 0; t < 3; t++) {
+    for (size_t i = 0; i < a.grad.size(); i++)
+      a.grad[i] = b.grad[i] = std::cos(static_cast<double>(i*(t + 1)));
+    serial.step();
+    sharded.step();
+    ASSERT_TRUE(std::ranges::equal(a.data, b.data));
+  }
+}
+
+TEST(MixedPrecisionTest, MasterWeightsKeepSmallUpdates) {
+  // lr 1e-9 is below half an ulp of float around the weights, so updates
+  // applied to the float weights directly are rounded away
+  const auto plain = std::make_shared<MLP<float>>(
+      std::vector<Layer<float>>{Layer<float>(4, 4, UnaryOp::relu)});
+  const auto mixed = std::make_shared<MLP<float>>(*plain);
+  Adam<float> plain_adam(plain, 1e-9);
+  Adam<float> mixed_adam(mixed, 1e-9, 0.9, 0.999, 1e-8, 1.0,
+                         StatePrecision::float32, true);
+  EXPECT_FALSE(plain_adam.has_master_weights());
+  ASSERT_TRUE(mixed_adam.has_master_weights());
+
+  const auto &p = plain->get_parameters()[0];
+  const auto &q = mixed->get_parameters()[0];
+  const std::vector<float> initial(p.data.begin(), p.data.end());
+  for (size_t t = 0; t < 2000; t++) {
+    std::ranges::fill(p.grad, 1.0f);
+    std::ranges::fill(q.grad, 1.0f);
+    plain_adam.step();
+    mixed_adam.step();
+  }
+  // weights start at He-initialised values of order 0.5 (except the 1e-5
+  // biases, which are small enough for float to resolve either way)
+  size_t moved_plain = 0, moved_mixed = 0;
+  for (size_t i = 0; i < 16; i++) {
+    moved_plain += p.data[i]!=initial[i];
+    moved_mixed += q.data[i]!=initial[i];
+  }
+  EXPECT_GT(moved_mixed, moved_plain);
+}
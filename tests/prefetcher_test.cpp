@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include <random>
+#include "../include/batch_sampler.hpp"
+#include "../include/components.hpp"
+#include "../include/losses.hpp"
+#include "../include/prefetcher.hpp"
+
+class PrefetcherTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    std::mt19937 gen(13);
+    std::uniform_int_distribution<int> pixel(0, 255);
+    for (size_t i = 0; i < 100; i++) labels.emplace_back(i%4);
+    images.resize(labels.size()*6);
+    for (auto &p : images) p = static_cast<uint8_t>(pixel(gen));
+    indices.resize(labels.size());
+    std::iota(indices.begin(), indices.end(), 0);
+  }
+
+  std::vector<uint8_t> images;
+  std::vector<uint8_t> labels;
+  std::vector<size_t> indices;
+};
+
+TEST_F(PrefetcherTest, HandsOutBatchesInOrder) {
+  BatchSampler sampler(images.data(), labels, 6, indices, 8, 1);
+  Prefetcher<double> prefetcher(3, 4);
+  for (size_t e = 0; e < 2; e++) {
+    prefetcher.reset();
+    sampler.set_epoch(e);
+    prefetcher.start(sampler.num_batches(), [&](const size_t i) {
+      return sampler.batch(i);
+    });
+    size_t i = 0;
+    while (const auto *batch = prefetcher.next()) {
+      const auto view = sampler.batch(i);
+      ASSERT_EQ(batch->index, i);
+      ASSERT_EQ(batch->rows, view.size());
+      ASSERT_EQ(batch->cols, 6);
+      std::vector<double> expected(view.size()*6);
+      view.gather(expected.data());
+      for (size_t j = 0; j < expected.size(); j++)
+        ASSERT_DOUBLE_EQ(batch->inputs[j], expected[j]);
+      for (size_t r = 0; r < view.size(); r++)
+        ASSERT_EQ(batch->labels[r], view.label(r));
+      ++i;
+    }
+    EXPECT_EQ(i, sampler.num_batches());
+    EXPECT_EQ(prefetcher.next(), nullptr);
+  }
+  const auto stats = prefetcher.stats();
+  EXPECT_EQ(stats.batches, 2*sampler.num_batches());
+  EXPECT_LE(stats.max_depth, 3);
+  EXPECT_GE(stats.stall_seconds, 0.0);
+}
+
+TEST_F(PrefetcherTest, AugmentAndErrors) {
+  const BatchView all(images.data(), labels.data(), 6, 0, 100);
+  Prefetcher<float> prefetcher(2, 2, {1, 0},
+                               [](PreparedBatch<float> &batch) {
+    for (auto &x : batch.inputs) x = 255 - x;
+  });
+  prefetcher.start(5, [&](const size_t i) {
+    if (i==3) throw std::out_of_range("no batch 3");
+    return all.subview(i*10, i*10 + 10);
+  });
+  for (size_t i = 0; i < 3; i++) {
+    const auto *batch = prefetcher.next();
+    ASSERT_NE(batch, nullptr);
+    EXPECT_EQ(batch->inputs[0], 255.0f - images[i*60]);
+  }
+  EXPECT_THROW(prefetcher.next(), std::out_of_range);
+  EXPECT_NE(prefetcher.next(), nullptr);
+  EXPECT_EQ(prefetcher.next(), nullptr);
+  // an epoch can be dropped half way
+  prefetcher.start(5, [&](const size_t i) {
+    return all.subview(i*10, i*10 + 10);
+  });
+  EXPECT_NE(prefetcher.next(), nullptr);
+  prefetcher.reset();
+  EXPECT_EQ(prefetcher.next(), nullptr);
+}
+
+TEST_F(PrefetcherTest, PreparedBatchLossMatchesView) {
+  const auto model = std::make_shared<MLP<double>>(std::vector<Layer<double>>{
+      Layer<double>{6, 5, UnaryOp::relu},
+      Layer<double>{5, 4, UnaryOp::softmax}});
+  const BatchView view(images.data(), labels.data(), 6, 20, 30);
+  SparseCCELoss<double> loss(model);
+  loss.compute_loss(view);
+  const double expected = loss.get();
+  loss.zero();
+
+  Prefetcher<double> prefetcher;
+  prefetcher.start(1, [&](size_t) { return view; });
+  const auto *batch = prefetcher.next();
+  loss.stream_backward(batch->inputs.data(), batch->cols, batch->labels, 7);
+  EXPECT_NEAR(loss.get(), expected, 1e-12);
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include "../include/components.hpp"
+#include "../include/distributed.hpp"
+#include "../include/losses.hpp"
+#include "../include/optimiser.hpp"
+#include "../include/process_group.hpp"
+#include "../include/trainer.hpp"
+
+class ProcessGroupTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/micrograd-test-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    socket_dir = dir;
+  }
+  void TearDown() override { rmdir(socket_dir.c_str()); }
+
+  /* Fork one process per rank and run body(group) in each. A rank fails by
+   * returning false or throwing; the test checks every exit status. */
+  void run_ranks(const size_t world_size,
+                 const std::function<bool(ProcessGroup &)> &body) const {
+    std::vector<pid_t> children;
+    for (size_t rank = 0; rank < world_size; rank++) {
+      const pid_t pid = fork();
+      ASSERT_GE(pid, 0);
+      if (pid==0) {
+        bool ok = false;
+        try {
+          ProcessGroup group(rank, world_size, socket_dir);
+          ok = body(group);
+        } catch (const std::exception &e) {
+          std::cerr << "rank " << rank << ": " << e.what() << '\n';
+        }
+        std::_Exit(ok ? 0 : 1);
+      }
+      children.emplace_back(pid);
+    }
+    for (size_t rank = 0; rank < world_size; rank++) {
+      int status = 0;
+      ASSERT_EQ(waitpid(children[rank], &status, 0), children[rank]);
+      EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status)==0)
+                << "rank " << rank << " failed";
+    }
+  }
+
+  std::string socket_dir;
+};
+
+TEST_F(ProcessGroupTest, AllReduceSums) {
+  for (const size_t world_size : {1, 2, 3, 4}) {
+    run_ranks(world_size, [&](ProcessGroup &group) {
+      /* sizes smaller than, equal to and not divisible by the world size */
+      for (const size_t n : {1, 3, 1000, 100'003}) {
+        std::vector<double> data(n);
+        std::vector<float> data_f(n);
+        for (size_t i = 0; i < n; i++) {
+          data[i] = static_cast<double>(group.rank() + 1) + 0.5*i;
+          data_f[i] = static_cast<float>(group.rank() + 1);
+        }
+        group.all_reduce(std::span<double>(data));
+        group.all_reduce_async(std::span<float>(data_f));
+        group.wait();
+        const double ranks = static_cast<double>(world_size);
+        for (size_t i = 0; i < n; i++) {
+          if (data[i]!=ranks*(ranks + 1)/2 + ranks*0.5*i) return false;
+          if (data_f[i]!=static_cast<float>(ranks*(ranks + 1)/2)) return false;
+        }
+      }
+      return true;
+    });
+  }
+}
+
+TEST_F(ProcessGroupTest, Broadcast) {
+  run_ranks(3, [](ProcessGroup &group) {
+    std::vector<double> data(5000, static_cast<double>(group.rank()));
+    group.broadcast(std::span<double>(data), 1);
+    return std::ranges::all_of(data, [](const double x) { return x==1.0; });
+  });
+}
+
+TEST_F(ProcessGroupTest, RejectsBadRank) {
+  EXPECT_THROW(ProcessGroup(2, 2, socket_dir), std::invalid_argument);
+}
+
+/* Three ranks each training on a third of every batch reproduce one process
+ * training on the whole batches, also in float with master weights, whose
+ * optimiser is built before the broadcast */
+TEST_F(ProcessGroupTest, DistributedTrainingMatchesSingleProcess) {
+  constexpr size_t world_size = 3;
+  auto check = [&]<typename T>(const bool master_weights, const T tolerance) {
+    std::mt19937 gen(13);
+    std::uniform_real_distribution<T> dist(0, 1);
+    std::vector<std::vector<std::vector<T>>> batches(4);
+    std::vector<std::vector<uint8_t>> targets(4);
+    for (size_t b = 0; b < batches.size(); b++) {
+      for (size_t i = 0; i < 31; i++) {
+        std::vector<T> x(12);
+        for (auto &v : x) v = dist(gen);
+        batches[b].emplace_back(std::move(x));
+        targets[b].emplace_back(static_cast<uint8_t>(i%3));
+      }
+    }
+    const auto initial = std::make_shared<const MLP<T>>(
+        std::vector<Layer<T>>{Layer<T>{12, 8, UnaryOp::relu},
+                              Layer<T>{8, 3, UnaryOp::softmax}});
+    auto make_adam = [&](const std::shared_ptr<const MLP<T>> &model) {
+      return Adam<T>(model, 1e-2, 0.9, 0.999, 1e-8, 1.0,
+                     StatePrecision::float64, master_weights);
+    };
+
+    const auto reference = std::make_shared<MLP<T>>(*initial);
+    {
+      SparseCCELoss<T> loss(reference);
+      auto adam = make_adam(reference);
+      for (size_t b = 0; b < batches.size(); b++) {
+        train_single_batch(std::shared_ptr<const MLP<T>>(reference),
+                           batches[b], targets[b], loss, adam);
+        loss.zero();
+      }
+    }
+
+    run_ranks(world_size, [&](ProcessGroup &group) {
+      /* only rank 0 starts from the initial weights, the broadcast must fix
+       * the others */
+      const auto model = std::make_shared<MLP<T>>(*initial);
+      if (group.rank()!=0)
+        for (auto &w : model->get_parameters()[0].data) w = 0;
+      auto adam = make_adam(model);
+      DistributedDataParallel<T, SparseCCELoss<T>> trainer(model, group);
+      for (size_t b = 0; b < batches.size(); b++) {
+        const size_t n = batches[b].size();
+        const size_t lo = n*group.rank()/world_size;
+        const size_t hi = n*(group.rank() + 1)/world_size;
+        trainer.train_batch(
+            std::span(batches[b]).subspan(lo, hi - lo),
+            std::span(targets[b]).subspan(lo, hi - lo), adam);
+      }
+      const auto &expected = reference->get_parameters()[0].data;
+      const auto &actual = model->get_parameters()[0].data;
+      for (size_t i = 0; i < expected.size(); i++)
+        if (std::abs(actual[i] - expected[i]) > tolerance) return false;
+      return true;
+    });
+  };
+  check(false, 1e-9);
+  check(true, 1e-5f);
+}
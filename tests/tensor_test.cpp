@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include "../include/components.hpp"
+#include "../include/tensor.hpp"
+
+class TensorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+  }
+
+  const std::vector<double> input0{0.1, 0.0, 0.3};
+  const std::vector<double> input1{0.0, 0.2, 0.4};
+
+  TensorValue<double> a{{1.0, 2.0, 3.0, 4.0, 5.0, 6.0}, 2, 3};
+  TensorValue<double> b{{0.5, -1.0, 2.0, 0.0, 1.0, -0.5}, 3, 2};
+};
+
+TEST_F(TensorTest, Matmul) {
+  const auto c = ops::matmul(a, b);
+  ASSERT_EQ(c.rows(), 2);
+  ASSERT_EQ(c.cols(), 2);
+  EXPECT_DOUBLE_EQ(c.get_data(0, 0), 0.5 + 4.0 + 3.0);
+  EXPECT_DOUBLE_EQ(c.get_data(0, 1), -1.0 + 0.0 - 1.5);
+  EXPECT_DOUBLE_EQ(c.get_data(1, 0), 2.0 + 10.0 + 6.0);
+  EXPECT_DOUBLE_EQ(c.get_data(1, 1), -4.0 + 0.0 - 3.0);
+  c.backward();
+  // d(sum C)/dA[i][k] = sum_j B[k][j], d(sum C)/dB[k][j] = sum_i A[i][k]
+  EXPECT_DOUBLE_EQ(a.get_grad(0, 0), -0.5);
+  EXPECT_DOUBLE_EQ(a.get_grad(1, 2), 0.5);
+  EXPECT_DOUBLE_EQ(b.get_grad(0, 1), 5.0);
+  EXPECT_DOUBLE_EQ(b.get_grad(2, 0), 9.0);
+}
+
+TEST_F(TensorTest, MatmulTransposed) {
+  const TensorValue<double> bt{{0.5, 2.0, 1.0, -1.0, 0.0, -0.5}, 2, 3};
+  const auto c = ops::matmul(a, bt, true);
+  EXPECT_DOUBLE_EQ(c.get_data(0, 0), 0.5 + 4.0 + 3.0);
+  EXPECT_DOUBLE_EQ(c.get_data(1, 1), -4.0 + 0.0 - 3.0);
+  c.backward();
+  EXPECT_DOUBLE_EQ(a.get_grad(0, 0), -0.5);
+  EXPECT_DOUBLE_EQ(bt.get_grad(1, 0), 5.0);
+}
+
+TEST_F(TensorTest, AddBiasRelu) {
+  const TensorValue<double> bias{{-2.0, 0.5, -10.0}, 1, 3};
+  const auto r = ops::relu(ops::add_bias(a, bias));
+  EXPECT_DOUBLE_EQ(r.get_data(0, 0), 0.0);
+  EXPECT_DOUBLE_EQ(r.get_data(1, 1), 5.5);
+  EXPECT_DOUBLE_EQ(r.get_data(1, 2), 0.0);
+  r.backward();
+  EXPECT_DOUBLE_EQ(a.get_grad(0, 0), 0.0);
+  EXPECT_DOUBLE_EQ(a.get_grad(1, 0), 1.0);
+  EXPECT_DOUBLE_EQ(bias.get_grad(0, 0), 1.0);
+  EXPECT_DOUBLE_EQ(bias.get_grad(0, 1), 2.0);
+  EXPECT_DOUBLE_EQ(bias.get_grad(0, 2), 0.0);
+}
+
+TEST_F(TensorTest, SoftmaxLogExp) {
+  const auto s = ops::softmax(a);
+  for (size_t i = 0; i < s.rows(); i++) {
+    double sum = 0;
+    for (size_t j = 0; j < s.cols(); j++) sum += s.get_data(i, j);
+    EXPECT_NEAR(sum, 1.0, 1e-12);
+  }
+  // sum of log(exp(x)) over the rows of softmax has zero grad wrt the logits
+  const auto l = ops::log(ops::exp(s));
+  l.backward();
+  for (size_t i = 0; i < a.size(); i++) EXPECT_NEAR(a.grad()[i], 0.0, 1e-12);
+}
+
+TEST_F(TensorTest, LayerMatchesScalarPath) {
+  const Layer<double> layer(3, 4, UnaryOp::relu);
+  const auto scalar = layer(input0);
+  Value<double> sum(0.0);
+  for (const auto &o : scalar) sum += o;
+  sum.backward();
+  std::vector<double> scalar_grads;
+  for (const auto &p : layer.get_parameters()) {
+    scalar_grads.insert(scalar_grads.end(), p.grad.begin(), p.grad.end());
+    std::ranges::fill(p.grad, 0.0);
+  }
+
+  const TensorValue<double> x(input0, 1, 3, false);
+  const auto tensor = layer(x);
+  ASSERT_EQ(tensor.cols(), scalar.size());
+  for (size_t j = 0; j < scalar.size(); j++)
+    EXPECT_NEAR(tensor.get_data(0, j), scalar[j].get_data(), 1e-12);
+  tensor.backward();
+  size_t i = 0;
+  for (const auto &p : layer.get_parameters())
+    for (const auto g : p.grad)
+      EXPECT_NEAR(g, scalar_grads[i++], 1e-12);
+  EXPECT_EQ(i, layer.num_params());
+}
+
+TEST_F(TensorTest, BatchedMLP) {
+  const MLP<double> model{{
+                              Layer<double>(3, 4, UnaryOp::relu),
+                              Layer<double>(4, 3, UnaryOp::softmax)
+                          }};
+  std::vector<double> batch(input0);
+  batch.insert(batch.end(), input1.begin(), input1.end());
+  const auto out = model(TensorValue<double>(batch, 2, 3, false));
+  ASSERT_EQ(out.rows(), 2);
+  for (size_t i = 0; i < 2; i++) {
+    const auto scalar = model(i ? input1 : input0);
+    for (size_t j = 0; j < scalar.size(); j++)
+      EXPECT_NEAR(out.get_data(i, j), scalar[j].get_data(), 1e-12);
+  }
+}
+
+TEST_F(TensorTest, SoftmaxCrossEntropyMatchesUnfused) {
+  const MLP<double> model{{
+                              Layer<double>(3, 4, UnaryOp::relu),
+                              Layer<double>(4, 3, UnaryOp::softmax)
+                          }};
+  const std::vector<std::vector<double>> batch{input0, input1};
+  const std::vector<uint8_t> targets{2, 0};
+  const auto &p = model.get_parameters()[0];
+
+  const auto unfused = ops::nll_loss(
+      model(TensorValue<double>(batch, false)), targets, 1e-7);
+  unfused.backward();
+  const std::vector<double> expected(p.grad.begin(), p.grad.end());
+  model.zero_grad();
+
+  const auto fused = ops::softmax_cross_entropy(
+      model.logits(TensorValue<double>(batch, false)), targets);
+  EXPECT_NEAR(fused.data()[0], unfused.data()[0], 1e-12);
+  fused.backward();
+  for (size_t i = 0; i < expected.size(); i++)
+    EXPECT_NEAR(p.grad[i], expected[i], 1e-12);
+
+  // the scalar path records one node per sample and agrees with the batch
+  auto scalar = ops::softmax_cross_entropy(model.logits(input0), 2);
+  scalar += ops::softmax_cross_entropy(model.logits(input1), 0);
+  EXPECT_NEAR(scalar.get_data()/2, fused.data()[0], 1e-12);
+}
+
+TEST(FloatTest, MatchesDouble) {
+  const MLP<double> model{{Layer<double>(3, 4, UnaryOp::relu),
+                           Layer<double>(4, 3, UnaryOp::softmax)}};
+  const MLP<float> model_f{{Layer<float>(3, 4, UnaryOp::relu),
+                            Layer<float>(4, 3, UnaryOp::softmax)}};
+  const auto &p = model.get_parameters()[0];
+  const auto &q = model_f.get_parameters()[0];
+  std::ranges::transform(p.data, q.data.begin(),
+                         [](const double w) { return static_cast<float>(w); });
+
+  const std::vector<std::vector<double>> batch{{0.1, 0.0, 0.3},
+                                               {0.0, 0.2, 0.4}};
+  const std::vector<std::vector<float>> batch_f{{0.1f, 0.0f, 0.3f},
+                                                {0.0f, 0.2f, 0.4f}};
+  const std::vector<uint8_t> targets{2, 0};
+  const auto loss = ops::nll_loss(
+      model(TensorValue<double>(batch, false)), targets, 1e-7);
+  const auto loss_f = ops::nll_loss(
+      model_f(TensorValue<float>(batch_f, false)), targets, 1e-7f);
+  EXPECT_NEAR(loss_f.data()[0], loss.data()[0], 1e-5);
+  loss.backward();
+  loss_f.backward();
+  for (size_t i = 0; i < p.grad.size(); i++)
+    EXPECT_NEAR(q.grad[i], p.grad[i], 1e-5);
+
+  // the scalar path instantiates for float too
+  const auto scalar = model_f(batch_f[0]);
+  EXPECT_NEAR(scalar[2].get_data(),
+              model(batch[0])[2].get_data(), 1e-5);
+}
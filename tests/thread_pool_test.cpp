@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include <stdexcept>
+#include "../include/thread_pool.hpp"
+
+class ThreadPoolTest : public testing::Test {
+ protected:
+  void SetUp() override {
+  }
+
+  ThreadPool pool{3};
+};
+
+TEST_F(ThreadPoolTest, ParallelForCoversRange) {
+  std::vector<int> hits(10'000, 0);
+  pool.parallel_for(0, hits.size(), [&](const size_t lo, const size_t hi) {
+    for (size_t i = lo; i < hi; i++) hits[i]++;
+  });
+  EXPECT_EQ(std::accumulate(hits.begin(), hits.end(), 0), 10'000);
+  EXPECT_EQ(*std::min_element(hits.begin(), hits.end()), 1);
+}
+
+TEST_F(ThreadPoolTest, Grain) {
+  std::atomic<size_t> chunks{0};
+  pool.parallel_for(0, 100, [&](const size_t lo, const size_t hi) {
+    EXPECT_TRUE(hi - lo==40 || hi==100);
+    chunks++;
+  }, 40);
+  EXPECT_EQ(chunks.load(), 3);
+}
+
+TEST_F(ThreadPoolTest, Submit) {
+  auto future = pool.submit([] { return 6*7; });
+  EXPECT_EQ(pool.wait(future), 42);
+}
+
+TEST_F(ThreadPoolTest, Nested) {
+  std::atomic<size_t> total{0};
+  pool.parallel_for(0, 8, [&](const size_t lo, const size_t hi) {
+    for (size_t i = lo; i < hi; i++) {
+      pool.parallel_for(0, 100, [&](const size_t l, const size_t h) {
+        total += h - l;
+      });
+    }
+  });
+  EXPECT_EQ(total.load(), 800);
+}
+
+TEST_F(ThreadPoolTest, RethrowsFirstException) {
+  EXPECT_THROW(pool.parallel_for(0, 100, [](const size_t lo, size_t) {
+    if (lo > 0) throw std::runtime_error("chunk failed");
+  }), std::runtime_error);
+  /* still usable afterwards */
+  auto future = pool.submit([] { return 1; });
+  EXPECT_EQ(pool.wait(future), 1);
+}
+
+TEST_F(ThreadPoolTest, Stats) {
+  pool.reset_stats();
+  for (int i = 0; i < 3; i++) {
+    pool.parallel_for(0, 1'000, [](size_t, size_t) {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    });
+  }
+  const auto stats = pool.stats();
+  ASSERT_EQ(stats.size(), 3);
+  uint64_t tasks = pool.external_stats().tasks_run;
+  for (const auto &s : stats) tasks += s.tasks_run;
+  /* 16 chunks per call, the first of which runs on the caller */
+  EXPECT_EQ(tasks, 3*15);
+}
+
+TEST(ThreadPoolInline, NoWorkers) {
+  ThreadPool pool(0);
+  size_t calls = 0;
+  pool.parallel_for(0, 10, [&](const size_t lo, const size_t hi) {
+    EXPECT_EQ(lo, 0);
+    EXPECT_EQ(hi, 10);
+    calls++;
+  });
+  EXPECT_EQ(calls, 1);
+  auto future = pool.submit([] { return 3; });
+  EXPECT_EQ(pool.wait(future), 3);
+}
@@ -154,4 +154,64 @@ TEST_F(ValueTest, Log) {
   EXPECT_EQ(t4.get_grad(), 1.0);
   EXPECT_EQ(t2.get_data(), 2.0);
   EXPECT_EQ(t2.get_grad(), 0.5);
-}
\ No newline at end of file
+}
+
+TEST_F(ValueTest, TapeReset) {
+  auto &tape = Tape<double>::get();
+  tape.mark_persistent();
+  const auto persistent = tape.size();
+  auto t = t2*t3 + t1;
+  EXPECT_EQ(tape.size(), persistent + 2);
+  t.backward();
+  EXPECT_EQ(t2.get_grad(), 1.0);
+  tape.reset();
+  EXPECT_EQ(tape.size(), persistent);
+  // leaves recorded before the watermark keep their data and grads
+  EXPECT_EQ(t2.get_data(), 2.0);
+  EXPECT_EQ(t2.get_grad(), 1.0);
+}
+
+TEST_F(ValueTest, SharedOperand) {
+  // a feeds two consumers, so its grad must be complete before it propagates
+  const auto a = s1*s2;
+  auto y = a*s3 + a*s2;
+  y.backward();
+  EXPECT_NEAR(a.get_grad(), 0.5, 1e-12);
+  EXPECT_NEAR(s1.get_grad(), 0.1, 1e-12);
+  EXPECT_NEAR(s3.get_grad(), 0.02, 1e-12);
+}
+
+TEST_F(ValueTest, Dot) {
+  const std::vector<Value<double>> w{t1, t2, t3};
+  const std::vector<Value<double>> x{s1, s0, s3};
+  const auto before = Tape<double>::get().size();
+  auto d = ops::dot(w, x, s2);
+  // a single node
+  EXPECT_EQ(Tape<double>::get().size(), before + 1);
+  EXPECT_NEAR(d.get_data(), 1.0*0.1 + 3.0*0.3 + 0.2, 1e-12);
+  d.backward();
+  EXPECT_NEAR(t1.get_grad(), 0.1, 1e-12);
+  EXPECT_EQ(t2.get_grad(), 0.0);
+  EXPECT_NEAR(t3.get_grad(), 0.3, 1e-12);
+  EXPECT_EQ(s1.get_grad(), 1.0);
+  // the zero input still receives its weight
+  EXPECT_EQ(s0.get_grad(), 1.0);
+  EXPECT_EQ(s2.get_grad(), 1.0);
+  // grads are clipped to 1 when the leaf is reached
+  EXPECT_EQ(s3.get_grad(), 1.0);
+}
+
+TEST_F(ValueTest, SoftmaxCrossEntropy) {
+  const std::vector<Value<double>> logits{s1, t2, m1};
+  const auto before = Tape<double>::get().size();
+  auto loss = ops::softmax_cross_entropy(logits, 1);
+  EXPECT_EQ(Tape<double>::get().size(), before + 1);
+  const double sum = std::exp(0.1) + std::exp(2.0) + std::exp(-1.0);
+  EXPECT_NEAR(loss.get_data(), std::log(sum) - 2.0, 1e-12);
+  loss.backward();
+  // softmax minus the one-hot target
+  EXPECT_NEAR(s1.get_grad(), std::exp(0.1)/sum, 1e-12);
+  EXPECT_NEAR(t2.get_grad(), std::exp(2.0)/sum - 1.0, 1e-12);
+  EXPECT_NEAR(m1.get_grad(), std::exp(-1.0)/sum, 1e-12);
+  EXPECT_THROW(ops::softmax_cross_entropy(logits, 3), std::invalid_argument);
+}